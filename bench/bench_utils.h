@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+inline int64_t bench_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// per-operation latencies, 1 ns resolution up to max_ns, everything above lands in the last bucket
+struct latency_log
+{
+    static constexpr size_t max_ns = 100000;
+
+    std::vector<uint64_t> histogram;
+    uint64_t count;
+
+    latency_log() : histogram(max_ns + 1, 0), count(0)
+    {
+    }
+    void add(int64_t ns)
+    {
+        histogram[static_cast<size_t>(std::min<int64_t>(std::max<int64_t>(ns, 0), max_ns))]++;
+        count++;
+    }
+    int64_t percentile(double p) const
+    {
+        const uint64_t target = static_cast<uint64_t>(static_cast<double>(count) * p);
+        uint64_t acc = 0;
+        for (size_t i = 0; i <= max_ns; i++) {
+            acc += histogram[i];
+            if (acc > target)
+                return static_cast<int64_t>(i);
+        }
+        return max_ns;
+    }
+};
+
+// keeps the optimizer from dropping the benchmarked work
+template <typename T>
+inline void do_not_optimize(const T &value)
+{
+#if defined(_MSC_VER)
+    static volatile const T *sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
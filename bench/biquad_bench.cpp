@@ -0,0 +1,323 @@
+// lane-parallel biquads against the per-channel recursion they replaced, ns per filtered sample
+// 2 channels is a stereo voice, 8 and 64 are what batching voices would give - every channel gets its own coefficients.
+// The state-space block kernel runs a channel at a time, its error is relative to the output's peak.
+// Then a stereo voice through a 2..8-pole cascade with its sections in the lanes, next to the single section,
+// and through the state variable cascade with the LFO sweeping its cutoff. Last, the error of both cascades for
+// every filter type and section count, the lane cascade's also against its own sections
+
+#include <math.h>
+#include <vector>
+
+#include "bench_utils.h"
+#include "dsp.h"
+#include "librandom.h"
+
+static constexpr size_t block_frames = FRAMES_PER_BUFFER;
+
+using channel_buffers = std::vector<std::vector<float>>;
+
+static void fill(channel_buffers &buffers, size_t num_channels)
+{
+    librandom::xoshiro256pp gen(1);
+    buffers.assign(num_channels, std::vector<float>(block_frames));
+    for (auto &channel : buffers)
+        for (float &s : channel)
+            s = gen.fp_s(1.0f);
+}
+
+static dsp::biquad::coefs channel_coefs(size_t ch)
+{
+    return dsp::biquad::low_pass<1>::compute(200.0f * static_cast<float>(ch + 1) / SAMPLE_RATE, 0.707f + 0.1f * ch);
+}
+
+template <typename F>
+static double time_blocks(F &&process, size_t num_channels, size_t num_blocks)
+{
+    const int64_t start = bench_now_ns();
+    for (size_t b = 0; b < num_blocks; b++)
+        process();
+    return static_cast<double>(bench_now_ns() - start) / static_cast<double>(num_blocks * block_frames * num_channels);
+}
+
+// the same input block over and over - the filter state keeps evolving, so nothing can be hoisted out
+static void run(size_t num_channels, bool avx2)
+{
+    const size_t num_blocks = 400000 / num_channels;
+    channel_buffers input, per_channel, x4, x8, block;
+    fill(input, num_channels);
+
+    std::vector<dsp::biquad::low_pass<1>> filters(num_channels);
+    std::vector<dsp::biquad::low_pass_x4> filters_x4((num_channels + 3) / 4);
+    std::vector<dsp::biquad::low_pass_x8> filters_x8((num_channels + 7) / 8);
+    std::vector<dsp::biquad::low_pass_block> filters_block(num_channels);
+    std::vector<float> block_state(4 * num_channels, 0.0f);
+    for (size_t ch = 0; ch < num_channels; ch++) {
+        filters[ch].set(channel_coefs(ch));
+        filters_x4[ch / 4].set(ch % 4, channel_coefs(ch));
+        filters_x8[ch / 8].set(ch % 8, channel_coefs(ch));
+        filters_block[ch].set(channel_coefs(ch));
+    }
+    auto process_block = [&](channel_buffers &buffers) {
+        for (size_t ch = 0; ch < num_channels; ch++) {
+            float *st = block_state.data() + 4 * ch;
+            filters_block[ch].process(block_frames, buffers[ch].data(), st[0], st[1], st[2], st[3]);
+        }
+    };
+
+    // correctness - a few blocks through each, from the same cleared state
+    per_channel = x4 = x8 = block = input;
+    std::vector<float *> ptr_x4(num_channels), ptr_x8(num_channels);
+    for (size_t ch = 0; ch < num_channels; ch++) {
+        ptr_x4[ch] = x4[ch].data();
+        ptr_x8[ch] = x8[ch].data();
+    }
+    float max_err = 0.0f, block_err = 0.0f, peak = 0.0f;
+    for (int b = 0; b < 4; b++) {
+        process_block(block);
+        for (size_t ch = 0; ch < num_channels; ch++)
+            filters[ch].process(block_frames, per_channel[ch].data());
+        for (size_t g = 0; g < filters_x4.size(); g++)
+            filters_x4[g].process(block_frames, ptr_x4.data() + 4 * g, std::min<size_t>(4, num_channels - 4 * g));
+        if (avx2) {
+            for (size_t g = 0; g < filters_x8.size(); g++)
+                filters_x8[g].process(block_frames, ptr_x8.data() + 8 * g, std::min<size_t>(8, num_channels - 8 * g));
+        }
+        for (size_t ch = 0; ch < num_channels; ch++) {
+            for (size_t i = 0; i < block_frames; i++) {
+                max_err = std::max(max_err, fabsf(x4[ch][i] - per_channel[ch][i]));
+                if (avx2)
+                    max_err = std::max(max_err, fabsf(x8[ch][i] - per_channel[ch][i]));
+                block_err = std::max(block_err, fabsf(block[ch][i] - per_channel[ch][i]));
+                peak = std::max(peak, fabsf(per_channel[ch][i]));
+            }
+        }
+    }
+
+    const double t_ref = time_blocks([&]() {
+        for (size_t ch = 0; ch < num_channels; ch++)
+            filters[ch].process(block_frames, per_channel[ch].data());
+        do_not_optimize(per_channel[0][0]);
+    }, num_channels, num_blocks);
+    const double t_x4 = time_blocks([&]() {
+        for (size_t g = 0; g < filters_x4.size(); g++)
+            filters_x4[g].process(block_frames, ptr_x4.data() + 4 * g, std::min<size_t>(4, num_channels - 4 * g));
+        do_not_optimize(x4[0][0]);
+    }, num_channels, num_blocks);
+    double t_x8 = 0.0;
+    if (avx2) {
+        t_x8 = time_blocks([&]() {
+            for (size_t g = 0; g < filters_x8.size(); g++)
+                filters_x8[g].process(block_frames, ptr_x8.data() + 8 * g, std::min<size_t>(8, num_channels - 8 * g));
+            do_not_optimize(x8[0][0]);
+        }, num_channels, num_blocks);
+    }
+    const double t_block = time_blocks([&]() {
+        process_block(block);
+        do_not_optimize(block[0][0]);
+    }, num_channels, num_blocks);
+    printf("%8zu %10.3fns %10.3fns %10.3fns %10.3fns %12g %12g\n", num_channels, t_ref, t_x4, t_x8, t_block, max_err,
+           block_err / peak);
+}
+
+static void run_cascade()
+{
+    constexpr size_t num_blocks = 200000;
+    channel_buffers buffers;
+    fill(buffers, NUM_CHANNELS);
+    float *channels[NUM_CHANNELS] = {buffers[0].data(), buffers[1].data()};
+
+    dsp::biquad::low_pass_x4 single;
+    single.set(channel_coefs(0));
+    const double t_single = time_blocks([&]() {
+        single.process(block_frames, channels, NUM_CHANNELS);
+        do_not_optimize(buffers[0][0]);
+    }, NUM_CHANNELS, num_blocks);
+    printf("\nstereo voice, ns per sample\n%8s %10s %10s\n", "", "biquads", "swept svf");
+    printf("%8s %10.3fns\n", "x4", t_single);
+
+    channel_buffers svf_buffers;
+    fill(svf_buffers, NUM_CHANNELS);
+    float *svf_channels[NUM_CHANNELS] = {svf_buffers[0].data(), svf_buffers[1].data()};
+    const dsp::modulation::wavetable w_table;
+    for (uint32_t num_sections = 1; num_sections <= 4; num_sections++) {
+        dsp::biquad::cascade<NUM_CHANNELS> cascade;
+        cascade.set(dsp::filter::compute(dsp::biquad::filter_type::low_pass, num_sections, 2000.0f, DEFAULT_LPF_Q, 0.0f));
+        const double t = time_blocks([&]() {
+            cascade.process(block_frames, channels, NUM_CHANNELS);
+            do_not_optimize(buffers[0][0]);
+        }, NUM_CHANNELS, num_blocks);
+
+        dsp::svf::cascade<NUM_CHANNELS> svf;
+        svf.set(dsp::filter::compute_modulated(dsp::biquad::filter_type::low_pass, num_sections, 2000.0f, DEFAULT_LPF_Q,
+                                               0.0f));
+        dsp::modulation::lfo lfo(&w_table);
+        lfo.set_increment(dsp::modulation::lfo::increment(5.0f) * FILTER_CONTROL_FRAMES, 1.0f);
+        // a fresh block every time - filtered in place over and over, the input goes to DC and the band state
+        // decays into denormals
+        const double t_svf = time_blocks([&]() {
+            for (size_t ch = 0; ch < NUM_CHANNELS; ch++)
+                memcpy(svf_channels[ch], channels[ch], sizeof(float) * block_frames);
+            svf.process(block_frames, svf_channels, NUM_CHANNELS, lfo);
+            do_not_optimize(svf_buffers[0][0]);
+        }, NUM_CHANNELS, num_blocks);
+        printf("%u poles %10.3fns %10.3fns\n", 2 * num_sections, t, t_svf);
+    }
+}
+
+// RBJ's sections in double precision, designed and run one after the other - the filter both cascades approximate
+struct serial_reference
+{
+    struct section
+    {
+        double b0, b1, b2, a1, a2; // normalized, a1, a2 negated
+        double x1, x2, y1, y2;
+    };
+    std::vector<section> sections;
+
+    serial_reference(dsp::biquad::filter_type type, uint32_t num_sections, double norm_freq, float r, double gain_db)
+    {
+        using dsp::biquad::filter_type;
+        for (uint32_t k = 0; k < num_sections; k++) {
+            const double w0 = 2.0 * M_PI * norm_freq;
+            const double cs = cos(w0);
+            const double alpha = sin(w0) / (2.0 * dsp::filter::section_q(type, num_sections, k, r));
+            double a0 = 1.0 + alpha, a1 = -2.0 * cs, a2 = 1.0 - alpha, b0, b1, b2;
+            switch (type) {
+            case filter_type::low_pass:
+            default:
+                b0 = b2 = 0.5 * (1.0 - cs);
+                b1 = 1.0 - cs;
+                break;
+            case filter_type::high_pass:
+                b0 = b2 = 0.5 * (1.0 + cs);
+                b1 = -(1.0 + cs);
+                break;
+            case filter_type::band_pass:
+                b0 = alpha;
+                b1 = 0.0;
+                b2 = -alpha;
+                break;
+            case filter_type::notch:
+                b0 = b2 = 1.0;
+                b1 = a1;
+                break;
+            case filter_type::low_shelf:
+            case filter_type::high_shelf: {
+                const double A = pow(10.0, gain_db / num_sections / 40.0);
+                const double sq = 2.0 * sqrt(A) * alpha;
+                const double c = (type == filter_type::low_shelf) ? cs : -cs;
+                const double sign = (type == filter_type::low_shelf) ? 1.0 : -1.0;
+                a0 = (A + 1) + (A - 1) * c + sq;
+                a1 = sign * -2.0 * ((A - 1) + (A + 1) * c);
+                a2 = (A + 1) + (A - 1) * c - sq;
+                b0 = A * ((A + 1) - (A - 1) * c + sq);
+                b1 = sign * 2.0 * A * ((A - 1) - (A + 1) * c);
+                b2 = A * ((A + 1) - (A - 1) * c - sq);
+                break;
+            }
+            }
+            sections.push_back({b0 / a0, b1 / a0, b2 / a0, -a1 / a0, -a2 / a0, 0.0, 0.0, 0.0, 0.0});
+        }
+    }
+    double process(double in)
+    {
+        for (section &s : sections) {
+            const double out = s.b0 * in + s.b1 * s.x1 + s.b2 * s.x2 + s.a1 * s.y1 + s.a2 * s.y2;
+            s.x2 = s.x1;
+            s.x1 = in;
+            s.y2 = s.y1;
+            s.y1 = out;
+            in = out;
+        }
+        return in;
+    }
+};
+
+// every type and section count, the worst case over the band filters' range of cutoffs and the range of q -
+// the lane cascade against its sections run in series through low_pass, then the lane cascade and the swept SVF
+// with the LFO at rest against the double precision reference. The cascades come num_sections - 1 samples late,
+// the errors are relative to the peak of what they're compared to
+static void check_cascades()
+{
+    constexpr size_t num_blocks = 64;
+    constexpr size_t num_frames = num_blocks * block_frames;
+    static const char *type_names[] = {"low pass", "high pass", "band pass", "notch", "low shelf", "high shelf"};
+    static_assert(sizeof(type_names) / sizeof(type_names[0]) == size_t(dsp::biquad::filter_type::count),
+                  "A name per filter type.");
+    librandom::xoshiro256pp gen(1);
+    channel_buffers input(NUM_CHANNELS, std::vector<float>(num_frames));
+    for (auto &channel : input)
+        for (float &s : channel)
+            s = gen.fp_s(1.0f);
+    const dsp::modulation::wavetable w_table;
+
+    printf("\nerror relative to the peak, the worst over cutoff and q\n%18s %12s %12s %12s\n", "", "vs. sections",
+           "vs. double", "svf at rest");
+    for (uint32_t t = 0; t < uint32_t(dsp::biquad::filter_type::count); t++) {
+        const auto type = static_cast<dsp::biquad::filter_type>(t);
+        for (uint32_t num_sections = 1; num_sections <= 4; num_sections++) {
+            double serial_err = 0.0, cascade_err = 0.0, svf_err = 0.0;
+            for (float f : {BAND_FILTER_MIN_FREQ, 1000.0f, BAND_FILTER_MAX_FREQ}) {
+                for (float r : {DEFAULT_LPF_Q, DEFAULT_LPF_Q + MAX_LPF_Q_DEVIATION}) {
+                    const dsp::filter::coefs c = dsp::filter::compute(type, num_sections, f, r, MAX_SHELF_GAIN_DB);
+                    dsp::biquad::cascade<NUM_CHANNELS> cascade;
+                    cascade.set(c);
+                    dsp::svf::cascade<NUM_CHANNELS> svf;
+                    svf.set(dsp::filter::compute_modulated(type, num_sections, f, r, MAX_SHELF_GAIN_DB));
+                    dsp::modulation::lfo lfo(&w_table);
+                    lfo.set_increment(dsp::modulation::lfo::increment(5.0f) * FILTER_CONTROL_FRAMES, 0.0f);
+
+                    channel_buffers serial = input, cascaded = input, swept = input;
+                    for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+                        for (uint32_t k = 0; k < num_sections; k++) {
+                            dsp::biquad::low_pass<1> section;
+                            section.set(c.section[k]);
+                            section.process(num_frames, serial[ch].data());
+                        }
+                    }
+                    for (size_t b = 0; b < num_blocks; b++) {
+                        float *cascade_channels[NUM_CHANNELS], *svf_channels[NUM_CHANNELS];
+                        for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+                            cascade_channels[ch] = cascaded[ch].data() + b * block_frames;
+                            svf_channels[ch] = swept[ch].data() + b * block_frames;
+                        }
+                        cascade.process(block_frames, cascade_channels, NUM_CHANNELS);
+                        svf.process(block_frames, svf_channels, NUM_CHANNELS, lfo);
+                    }
+
+                    const size_t latency = num_sections - 1;
+                    double serial_diff = 0.0, cascade_diff = 0.0, svf_diff = 0.0, serial_peak = 0.0, ref_peak = 0.0;
+                    for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+                        serial_reference ref(type, num_sections, f / SAMPLE_RATE, r, MAX_SHELF_GAIN_DB);
+                        for (size_t i = 0; i + latency < num_frames; i++) {
+                            const double expected = ref.process(input[ch][i]);
+                            const double out = cascaded[ch][i + latency];
+                            serial_diff = std::max(serial_diff, fabs(out - serial[ch][i]));
+                            cascade_diff = std::max(cascade_diff, fabs(out - expected));
+                            svf_diff = std::max(svf_diff, fabs(swept[ch][i + latency] - expected));
+                            serial_peak = std::max(serial_peak, fabs(double(serial[ch][i])));
+                            ref_peak = std::max(ref_peak, fabs(expected));
+                        }
+                    }
+                    serial_err = std::max(serial_err, serial_diff / serial_peak);
+                    cascade_err = std::max(cascade_err, cascade_diff / ref_peak);
+                    svf_err = std::max(svf_err, svf_diff / ref_peak);
+                }
+            }
+            printf("%10s %u poles %12g %12g %12g\n", type_names[t], 2 * num_sections, serial_err, cascade_err, svf_err);
+        }
+    }
+}
+
+int main()
+{
+    const bool avx2 = cpu_has_avx2_fma();
+    if (!avx2)
+        puts("no AVX2 on this CPU, the x8 column is skipped");
+    printf("%8s %12s %12s %12s %12s %12s %12s\n", "channels", "per channel", "x4", "x8", "block", "max err", "block err");
+    for (size_t num_channels : {1, 2, 8, 64})
+        run(num_channels, avx2);
+    run_cascade();
+    check_cascades();
+    return 0;
+}
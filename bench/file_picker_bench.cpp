@@ -0,0 +1,109 @@
+// shuffle bag against the 32-bit mask + linear probe it replaced, ns per drawn file id
+// the mask only works up to 32 files, so it's measured at that size only
+
+#include <type_traits>
+
+#include "bench_utils.h"
+#include "librandom.h"
+#include "shuffle_bag.h"
+
+template <typename T = uint32_t>
+struct cache_t
+{
+    static_assert(std::is_integral_v<T>, "Unsupported type!");
+
+    inline cache_t(const T v = 0) : _cache(v)
+    {
+    }
+    inline T value() const
+    {
+        return _cache;
+    }
+    inline T check(T idx, const uint8_t size)
+    {
+        check_all(size);
+        while (!check_cache(static_cast<uint8_t>(idx), size)) {
+            if (++idx >= size)
+                idx = 0;
+        }
+        if (check_all(size))
+            check_cache(static_cast<uint8_t>(idx), size);
+        return (idx);
+    }
+    inline int check_all(const uint8_t size)
+    {
+        const T nall = static_cast<T>((uint64_t(-1) << size));
+        const T all = ~nall;
+        if ((all & _cache) != all)
+            return (false);
+        _cache &= nall;
+        return (true);
+    }
+    inline int check_cache(const uint8_t idx, const uint8_t size)
+    {
+        const T mask = (static_cast<T>((uint64_t(1) << idx)) & ~(static_cast<T>(uint64_t(-1) << size)));
+        if (_cache & mask)
+            return (false);
+        _cache |= mask;
+        return (true);
+    }
+
+  private:
+    T _cache;
+};
+
+static void run_mask(size_t num_files, size_t num_draws)
+{
+    librandom::xoshiro256pp gen(1);
+    uint32_t cache_id = 0;
+    uint64_t sum = 0;
+    const int64_t start = bench_now_ns();
+    for (size_t i = 0; i < num_draws; i++) {
+        uint32_t id = static_cast<uint32_t>(gen.i(static_cast<int32_t>(num_files)));
+        cache_t<uint32_t> cache(cache_id);
+        id = cache.check(id, static_cast<uint8_t>(num_files));
+        cache_id = cache.value();
+        sum += id;
+    }
+    const double ns = static_cast<double>(bench_now_ns() - start) / static_cast<double>(num_draws);
+    do_not_optimize(sum);
+    printf("mask + probe %8zu files %8.1f ns/draw\n", num_files, ns);
+}
+
+static void run_bag(size_t num_files, size_t num_draws)
+{
+    librandom::xoshiro256pp gen(1);
+    shuffle_bag bag;
+    bag.init(num_files);
+    // every id exactly once per cycle, and never the same id twice in a row
+    std::vector<uint32_t> seen(num_files, 0);
+    uint32_t last = UINT32_MAX;
+    for (size_t i = 0; i < 3 * num_files; i++) {
+        const uint32_t id = bag.draw(gen.u32());
+        if (id == last || seen[id] != (i / num_files)) {
+            printf("shuffle bag  %8zu files - repeat at draw %zu\n", num_files, i);
+            return;
+        }
+        seen[id]++;
+        last = id;
+    }
+
+    uint64_t sum = 0;
+    const int64_t start = bench_now_ns();
+    for (size_t i = 0; i < num_draws; i++) {
+        sum += bag.draw(gen.u32());
+    }
+    const double ns = static_cast<double>(bench_now_ns() - start) / static_cast<double>(num_draws);
+    do_not_optimize(sum);
+    printf("shuffle bag  %8zu files %8.1f ns/draw\n", num_files, ns);
+}
+
+int main()
+{
+    constexpr size_t num_draws = 10000000;
+    run_mask(32, num_draws);
+    run_bag(32, num_draws);
+    run_bag(1000, num_draws);
+    run_bag(100000, num_draws);
+    return 0;
+}
@@ -0,0 +1,68 @@
+// filling a buffer with uniform floats, ns per float - xoshiro256++ a float at a time against the 8-lane
+// xoshiro128+ batch generator, through SSE2 and AVX2. The two kernels have to give the same buffer for a seed,
+// a length that isn't a multiple of the lanes included
+
+#include <vector>
+
+#include "bench_utils.h"
+#include "librandom.h"
+
+static constexpr size_t buffer_floats = 4096;
+
+template <typename F>
+static double time_fills(F &&fill, size_t num_fills)
+{
+    const int64_t start = bench_now_ns();
+    for (size_t i = 0; i < num_fills; i++)
+        fill();
+    return static_cast<double>(bench_now_ns() - start) / static_cast<double>(num_fills * buffer_floats);
+}
+
+// the same fills through both kernels, from the same seed - the state carries over from one fill to the next
+static size_t count_mismatches()
+{
+    librandom::xoshiro128p_x8 sse2(7), avx2(7);
+    std::vector<float> a(buffer_floats), b(buffer_floats);
+    size_t mismatches = 0;
+    for (size_t count : {buffer_floats, size_t(1), size_t(13), size_t(1021), buffer_floats}) {
+        sse2.fill_sse2(a.data(), count, -1.0f, 1.0f);
+        avx2.fill_avx2(b.data(), count, -1.0f, 1.0f);
+        for (size_t i = 0; i < count; i++)
+            mismatches += (memcmp(&a[i], &b[i], sizeof(float)) != 0);
+    }
+    return mismatches;
+}
+
+int main()
+{
+    constexpr size_t num_fills = 20000;
+    const bool avx2 = cpu_has_avx2_fma();
+    std::vector<float> buffer(buffer_floats);
+
+    librandom::xoshiro256pp scalar(1);
+    const double t_scalar = time_fills([&]() {
+        for (float &s : buffer)
+            s = scalar.fp(-1.0f, 1.0f);
+        do_not_optimize(buffer[0]);
+    }, num_fills);
+    librandom::xoshiro128p_x8 batch(1);
+    const double t_sse2 = time_fills([&]() {
+        batch.fill_sse2(buffer.data(), buffer.size(), -1.0f, 1.0f);
+        do_not_optimize(buffer[0]);
+    }, num_fills);
+    printf("%12s %12s\n", "generator", "ns/float");
+    printf("%12s %10.3fns\n", "xoshiro256++", t_scalar);
+    printf("%12s %10.3fns\n", "x8 sse2", t_sse2);
+    if (!avx2) {
+        puts("no AVX2 on this CPU, the avx2 kernel is skipped");
+        return 0;
+    }
+    const double t_avx2 = time_fills([&]() {
+        batch.fill_avx2(buffer.data(), buffer.size(), -1.0f, 1.0f);
+        do_not_optimize(buffer[0]);
+    }, num_fills);
+    printf("%12s %10.3fns\n", "x8 avx2", t_avx2);
+    const size_t mismatches = count_mismatches();
+    printf("sse2 vs. avx2: %zu floats differ\n", mismatches);
+    return mismatches ? 1 : 0;
+}
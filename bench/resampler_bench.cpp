@@ -0,0 +1,194 @@
+// linear resampler kernels against the per-sample bounds-checked loop they replaced, ns per output sample
+// pitch ratios span +-12 semitones, one block of FRAMES_PER_BUFFER outputs per call like in the voice renderer,
+// planar source (cached samples) and interleaved stereo (mapped fp32 files).
+// The polyphase sinc mode is reported in voices per core at 48 kHz (resampling only, one channel), together with
+// the aliasing of a 17 kHz sine pitched up an octave - all of its output is alias
+
+#include <math.h>
+#include <vector>
+
+#include "bench_utils.h"
+#include "librandom.h"
+#include "resampler.h"
+
+static constexpr size_t block_frames = 1024;
+static constexpr size_t source_frames = 1 << 20;
+
+// the old inner loop, including the bounds check it did for every output sample
+static size_t resample_reference(const uint8_t *src, size_t stride, size_t num_frames, size_t file_offset, float d,
+                                 float *dest, size_t out_samples)
+{
+    size_t i = 1;
+    for (size_t j = file_offset + 1; i < out_samples; i++) {
+        const float x = float(i) * d;
+        const int y = int(x);
+        const float z = x - float(y);
+        const size_t idx = j + static_cast<size_t>(y);
+        if ((idx + 1) >= num_frames)
+            break;
+        dest[i] = resampler::load_sample(src, stride, idx) * (1.0f - z) + resampler::load_sample(src, stride, idx + 1) * z;
+    }
+    return i;
+}
+
+using kernel_t = void (*)(const uint8_t *, size_t, size_t, float, float, float *, size_t, size_t);
+
+static void resample_kernel(kernel_t kernel, const uint8_t *src, size_t stride, size_t num_frames, size_t file_offset,
+                            float d, float *dest, size_t out_samples)
+{
+    const size_t end = resampler::linear_safe_end(file_offset + 1, d, 0.0f, num_frames, 1, out_samples);
+    kernel(src, stride, file_offset + 1, d, 0.0f, dest, 1, end);
+}
+
+template <typename F>
+static double time_blocks(F &&process, float d, size_t num_blocks)
+{
+    const size_t in_per_block = static_cast<size_t>(static_cast<float>(block_frames) * d);
+    size_t offset = 0;
+    const int64_t start = bench_now_ns();
+    for (size_t b = 0; b < num_blocks; b++) {
+        process(offset);
+        offset += in_per_block;
+        if ((offset + 2 * in_per_block + 2) >= source_frames)
+            offset = 0;
+    }
+    return static_cast<double>(bench_now_ns() - start) / static_cast<double>(num_blocks * block_frames);
+}
+
+static void run(const char *layout, const std::vector<float> &source, size_t stride_floats, bool avx2)
+{
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(source.data());
+    const size_t stride = stride_floats * sizeof(float);
+    const size_t num_frames = source.size() / stride_floats;
+    std::vector<float> ref(block_frames), out(block_frames);
+    constexpr size_t num_blocks = 20000;
+
+    printf("%s\n%10s %8s %10s %10s %10s %12s\n", layout, "semitones", "ratio", "scalar", "sse2", "avx2", "max err");
+    for (int semitones = -12; semitones <= 12; semitones += 3) {
+        if (!semitones)
+            continue; // equal lengths are copied, not resampled
+        const float d = powf(2.0f, static_cast<float>(semitones) / 12.0f);
+
+        // correctness - every kernel against the reference on the same blocks, including the end of the source
+        float max_err = 0.0f;
+        for (size_t offset : {size_t(0), size_t(12345), num_frames - block_frames}) {
+            const size_t end = resample_reference(src, stride, num_frames, offset, d, ref.data(), block_frames);
+            for (kernel_t k : {resampler::linear_scalar, resampler::linear_sse2, avx2 ? resampler::linear_avx2 : nullptr}) {
+                if (!k)
+                    continue;
+                if (resampler::linear_safe_end(offset + 1, d, 0.0f, num_frames, 1, block_frames) != end)
+                    max_err = INFINITY;
+                resample_kernel(k, src, stride, num_frames, offset, d, out.data(), block_frames);
+                for (size_t i = 1; i < end; i++)
+                    max_err = std::max(max_err, fabsf(out[i] - ref[i]));
+            }
+        }
+
+        const double t_ref = time_blocks([&](size_t offset) {
+            resample_reference(src, stride, num_frames, offset, d, ref.data(), block_frames);
+            do_not_optimize(ref[block_frames - 1]);
+        }, d, num_blocks);
+        const double t_sse = time_blocks([&](size_t offset) {
+            resample_kernel(resampler::linear_sse2, src, stride, num_frames, offset, d, out.data(), block_frames);
+            do_not_optimize(out[block_frames - 1]);
+        }, d, num_blocks);
+        double t_avx = 0.0;
+        if (avx2) {
+            t_avx = time_blocks([&](size_t offset) {
+                resample_kernel(resampler::linear_avx2, src, stride, num_frames, offset, d, out.data(), block_frames);
+                do_not_optimize(out[block_frames - 1]);
+            }, d, num_blocks);
+        }
+        printf("%10d %8.3f %8.3fns %8.3fns %8.3fns %12g\n", semitones, d, t_ref, t_sse, t_avx, max_err);
+    }
+}
+
+using sinc_kernel_t = void (*)(const uint8_t *, size_t, size_t, float, float, const float *, float *, size_t, size_t);
+
+static void sinc_kernel(sinc_kernel_t kernel, const uint8_t *src, size_t stride, size_t file_offset, float d, float *dest,
+                        size_t out_samples)
+{
+    kernel(src, stride, file_offset + 1, d, 0.0f, resampler::sinc_coefs.band(d), dest, 1, out_samples);
+}
+
+static double voices_per_core(double ns_per_sample)
+{
+    return 1e9 / (ns_per_sample * SAMPLE_RATE);
+}
+
+static float alias_db(bool sinc)
+{
+    constexpr float d = 2.0f;
+    std::vector<float> sine(4 * block_frames);
+    for (size_t i = 0; i < sine.size(); i++)
+        sine[i] = sinf(2.0f * PI * 17000.0f * static_cast<float>(i) / SAMPLE_RATE);
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(sine.data());
+    std::vector<float> out(block_frames);
+    const size_t offset = block_frames / 2;
+    if (sinc) {
+        resampler::sinc(src, sizeof(float), sine.size(), offset + 1, d, 0.0f, out.data(), 1, block_frames);
+    } else {
+        resampler::linear(src, sizeof(float), offset + 1, d, 0.0f, out.data(), 1, block_frames);
+    }
+    double energy = 0.0;
+    for (size_t i = 1; i < block_frames; i++)
+        energy += static_cast<double>(out[i]) * out[i];
+    return static_cast<float>(10.0 * log10(energy / static_cast<double>(block_frames - 1) / 0.5));
+}
+
+static void run_sinc(const char *layout, const std::vector<float> &source, size_t stride_floats, bool avx2)
+{
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(source.data());
+    const size_t stride = stride_floats * sizeof(float);
+    std::vector<float> out(block_frames);
+    constexpr size_t num_blocks = 5000;
+
+    printf("%s, voices per core\n%10s %8s %10s %10s %10s\n", layout, "semitones", "ratio", "linear", "sinc sse2", "sinc avx2");
+    for (int semitones = -12; semitones <= 12; semitones += 6) {
+        if (!semitones)
+            continue;
+        const float d = powf(2.0f, static_cast<float>(semitones) / 12.0f);
+        const double t_lin = time_blocks([&](size_t offset) {
+            resample_kernel(resampler::linear, src, stride, source.size() / stride_floats, offset + 16, d, out.data(), block_frames);
+            do_not_optimize(out[block_frames - 1]);
+        }, d, num_blocks);
+        auto sse = (stride_floats == 1) ? resampler::sinc_sse2<true> : resampler::sinc_sse2<false>;
+        const double t_sse = time_blocks([&](size_t offset) {
+            sinc_kernel(sse, src, stride, offset + 16, d, out.data(), block_frames);
+            do_not_optimize(out[block_frames - 1]);
+        }, d, num_blocks);
+        double t_avx = 0.0;
+        if (avx2) {
+            auto avx = (stride_floats == 1) ? resampler::sinc_avx2<true> : resampler::sinc_avx2<false>;
+            t_avx = time_blocks([&](size_t offset) {
+                sinc_kernel(avx, src, stride, offset + 16, d, out.data(), block_frames);
+                do_not_optimize(out[block_frames - 1]);
+            }, d, num_blocks);
+        }
+        printf("%10d %8.3f %10.0f %10.0f %10.0f\n", semitones, d, voices_per_core(t_lin), voices_per_core(t_sse),
+               avx2 ? voices_per_core(t_avx) : 0.0);
+    }
+}
+
+int main()
+{
+    const bool avx2 = cpu_has_avx2_fma();
+    if (!avx2)
+        puts("no AVX2 on this CPU, the avx2 column is skipped");
+
+    librandom::xoshiro256pp gen(1);
+    std::vector<float> planar(source_frames), interleaved(source_frames * 2);
+    for (float &s : planar)
+        s = gen.fp_s(1.0f);
+    for (float &s : interleaved)
+        s = gen.fp_s(1.0f);
+
+    run("planar", planar, 1, avx2);
+    run("interleaved stereo", interleaved, 2, avx2);
+
+    resampler::sinc_coefs.init();
+    run_sinc("planar", planar, 1, avx2);
+    run_sinc("interleaved stereo", interleaved, 2, avx2);
+    printf("17 kHz sine an octave up, alias level: linear %.1f dB, sinc %.1f dB\n", alias_db(false), alias_db(true));
+    return 0;
+}
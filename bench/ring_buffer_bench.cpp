@@ -0,0 +1,103 @@
+// circular_buffer (wait-free SPSC) against the spinlock-guarded ring it replaced
+// reports ops/s and the p99.9 latency of a single try_push / try_pop call
+
+#include <thread>
+
+#include "bench_utils.h"
+#include "circular_buffer.h"
+#include "spinlock.h"
+
+template <typename T, size_t sz_pow_2>
+class spinlock_circular_buffer
+{
+    static constexpr size_t capacity = 1 << sz_pow_2;
+
+    std::array<T, capacity> queue;
+    uint32_t read_idx;
+    uint32_t write_idx;
+    std::atomic<uint32_t> size{0};
+    spinlock guard;
+public:
+    spinlock_circular_buffer() : read_idx(0), write_idx(0) {}
+
+    bool is_empty() const { return (size.load() == 0); }
+    bool is_full() const { return (size.load() == capacity); }
+
+    bool try_pop(T &item)
+    {
+        guard.lock();
+        if (is_empty()) {
+            guard.unlock();
+            return false;
+        }
+        item = queue[read_idx];
+        std::atomic_fetch_add(&size, -1);
+        read_idx = (read_idx + 1) & (capacity - 1);
+        guard.unlock();
+        return true;
+    }
+    bool try_push(const T task)
+    {
+        guard.lock();
+        if (is_full()) {
+            guard.unlock();
+            return false;
+        }
+        queue[write_idx] = task;
+        std::atomic_fetch_add(&size, 1);
+        write_idx = (write_idx + 1) & (capacity - 1);
+        guard.unlock();
+        return true;
+    }
+};
+
+template <typename queue_t>
+static void run(const char *name, size_t num_ops)
+{
+    queue_t *queue = new queue_t();
+    latency_log push_lat;
+    latency_log pop_lat;
+
+    const int64_t start = bench_now_ns();
+    std::thread producer([&]() {
+        for (size_t i = 0; i < num_ops;) {
+            const int64_t t0 = bench_now_ns();
+            const bool res = queue->try_push(i);
+            push_lat.add(bench_now_ns() - t0);
+            if (res)
+                i++;
+            else
+                std::this_thread::yield();
+        }
+    });
+    size_t checksum = 0;
+    for (size_t i = 0; i < num_ops;) {
+        size_t item;
+        const int64_t t0 = bench_now_ns();
+        const bool res = queue->try_pop(item);
+        pop_lat.add(bench_now_ns() - t0);
+        if (res) {
+            checksum += item;
+            i++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    const double sec = static_cast<double>(bench_now_ns() - start) * 1e-9;
+    do_not_optimize(checksum);
+
+    printf("%-24s %12.0f ops/s   push p99.9 %6lld ns   pop p99.9 %6lld ns\n", name, static_cast<double>(num_ops) / sec,
+           static_cast<long long>(push_lat.percentile(0.999)), static_cast<long long>(pop_lat.percentile(0.999)));
+    delete queue;
+}
+
+int main()
+{
+    constexpr size_t num_ops = 1000000;
+    run<spinlock_circular_buffer<size_t, 3>>("spinlock ring (8)", num_ops);
+    run<circular_buffer<size_t, 3>>("spsc ring (8)", num_ops);
+    run<spinlock_circular_buffer<size_t, 10>>("spinlock ring (1024)", num_ops);
+    run<circular_buffer<size_t, 10>>("spsc ring (1024)", num_ops);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// futex-backed semaphore against the mutex + condition_variable one it replaced
+// uncontended: signal + wait on the same thread, the semaphore is always already signaled
+// ping-pong: signal -> wake-up latency between two threads blocking on each other
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bench_utils.h"
+#include "semaphore.h"
+
+class semaphore_cv
+{
+	std::mutex m;
+	std::condition_variable cv;
+	volatile int ready = 0;
+public:
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(m);
+		cv.wait(lock, [this]() { return this->ready; });
+		this->ready = 0;
+	}
+	void signal()
+	{
+		{
+			std::unique_lock<std::mutex> lock(m);
+			ready = 1;
+		}
+		cv.notify_one();
+	}
+};
+
+template <typename sem_t>
+static void run_uncontended(const char *name, size_t num_ops)
+{
+    sem_t sem;
+    const int64_t start = bench_now_ns();
+    for (size_t i = 0; i < num_ops; i++) {
+        sem.signal();
+        sem.wait();
+    }
+    const double sec = static_cast<double>(bench_now_ns() - start) * 1e-9;
+    printf("%-12s uncontended %12.0f signal+wait/s\n", name, static_cast<double>(num_ops) / sec);
+}
+
+template <typename sem_t>
+static void run_ping_pong(const char *name, size_t num_ops)
+{
+    sem_t ping, pong;
+    std::atomic<int64_t> signal_ns{0};
+    latency_log wake_lat;
+
+    std::thread responder([&]() {
+        for (size_t i = 0; i < num_ops; i++) {
+            ping.wait();
+            wake_lat.add(bench_now_ns() - signal_ns.load(std::memory_order_relaxed));
+            pong.signal();
+        }
+    });
+    const int64_t start = bench_now_ns();
+    for (size_t i = 0; i < num_ops; i++) {
+        signal_ns.store(bench_now_ns(), std::memory_order_relaxed);
+        ping.signal();
+        pong.wait();
+    }
+    responder.join();
+    const double sec = static_cast<double>(bench_now_ns() - start) * 1e-9;
+    printf("%-12s ping-pong   %12.0f round trips/s   wake-up p50 %6lld ns   p99 %6lld ns\n", name,
+           static_cast<double>(num_ops) / sec, static_cast<long long>(wake_lat.percentile(0.5)),
+           static_cast<long long>(wake_lat.percentile(0.99)));
+}
+
+int main()
+{
+    run_uncontended<semaphore_cv>("mutex + cv", 10000000);
+    run_uncontended<semaphore>("futex", 10000000);
+    run_ping_pong<semaphore_cv>("mutex + cv", 200000);
+    run_ping_pong<semaphore>("futex", 200000);
+    return 0;
+}
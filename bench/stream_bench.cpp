@@ -0,0 +1,126 @@
+// a streamed voice against a streamer thread that falls behind it - every wake-up of the streamer is delayed by a
+// simulated slow disk, so the voice reaches chunks before they're loaded.
+// The voice holds its position while the chunk is missing (skipped blocks), or waits for it like an offline render;
+// either way it has to get to the end of the file with every frame intact, a voice that makes no progress for a
+// second is reported as stalled
+
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "bench_utils.h"
+#include "sample_stream.h"
+#include "semaphore.h"
+#include "wav_file.h"
+
+static constexpr const char *file_path = "stream_bench.wav";
+static constexpr size_t file_frames = 8 * STREAM_CHUNK_FRAMES + FRAMES_PER_BUFFER / 2;
+static constexpr int64_t stall_ns = 1000000000;
+
+// exact in fp32 for every frame of the file
+static float expected_sample(size_t frame, size_t ch)
+{
+    return ch ? -static_cast<float>(frame) : static_cast<float>(frame);
+}
+
+static bool write_file()
+{
+    wav_writer writer;
+    if (!writer.open(file_path, NUM_CHANNELS, 48000))
+        return false;
+    std::vector<float> frames(FRAMES_PER_BUFFER * NUM_CHANNELS);
+    for (size_t first = 0; first < file_frames; first += FRAMES_PER_BUFFER) {
+        const size_t num_frames = std::min<size_t>(FRAMES_PER_BUFFER, file_frames - first);
+        for (size_t i = 0; i < num_frames; i++) {
+            for (size_t ch = 0; ch < NUM_CHANNELS; ch++)
+                frames[i * NUM_CHANNELS + ch] = expected_sample(first + i, ch);
+        }
+        if (!writer.write(frames.data(), num_frames))
+            return false;
+    }
+    return writer.close();
+}
+
+struct run_result
+{
+    size_t skipped_blocks = 0;
+    size_t bad_frames = 0;
+    bool stalled = false;
+    double ms = 0.0;
+};
+
+static run_result play_stream(int64_t disk_delay_us, bool wait)
+{
+    run_result result;
+    semaphore wake;
+    sample_stream stream;
+    if (!stream.open(file_path, &wake)) {
+        result.stalled = true;
+        return result;
+    }
+    std::atomic<bool> running{true};
+    std::thread streamer([&]() {
+        while (running.load(std::memory_order_relaxed)) {
+            wake.wait();
+            std::this_thread::sleep_for(std::chrono::microseconds(disk_delay_us));
+            stream.service();
+        }
+    });
+
+    const int64_t start = bench_now_ns();
+    int64_t last_progress = start;
+    for (size_t frame = 0; frame < file_frames;) {
+        sample_view view;
+        size_t offset;
+        if (!stream.view(frame, view, offset, wait)) {
+            result.skipped_blocks++;
+            if (bench_now_ns() - last_progress > stall_ns) {
+                result.stalled = true;
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        const size_t num_frames = std::min<size_t>(FRAMES_PER_BUFFER, file_frames - frame);
+        for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+            const float *samples = reinterpret_cast<const float *>(view.channels[ch]);
+            for (size_t i = 0; i < num_frames; i++)
+                result.bad_frames += (samples[offset + i] != expected_sample(frame + i, ch));
+        }
+        frame += FRAMES_PER_BUFFER;
+        last_progress = bench_now_ns();
+    }
+    result.ms = static_cast<double>(bench_now_ns() - start) * 1e-6;
+
+    running.store(false, std::memory_order_relaxed);
+    wake.signal();
+    streamer.join();
+    stream.release();
+    return result;
+}
+
+int main()
+{
+    if (!write_file()) {
+        printf("Failed to write %s.\n", file_path);
+        return 1;
+    }
+    bool ok = true;
+    printf("%10s %8s %10s %10s %10s %10s\n", "disk delay", "mode", "skipped", "bad frames", "stalled", "time");
+    for (int64_t delay_us : {0, 100, 1000, 5000}) {
+        for (bool wait : {false, true}) {
+            const run_result r = play_stream(delay_us, wait);
+            printf("%8lldus %8s %10zu %10zu %10s %8.1fms\n", static_cast<long long>(delay_us), wait ? "wait" : "skip",
+                   r.skipped_blocks, r.bad_frames, r.stalled ? "yes" : "no", r.ms);
+            fflush(stdout);
+            ok &= !r.stalled && !r.bad_frames && !(wait && r.skipped_blocks);
+            if (r.stalled) {
+                // a waiting voice would never return
+                break;
+            }
+        }
+    }
+    remove(file_path);
+    puts(ok ? "every run played the whole file" : "FAILED");
+    return ok ? 0 : 1;
+}
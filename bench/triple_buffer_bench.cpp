@@ -0,0 +1,100 @@
+// triple_buffer under contention: the producer publishes as fast as it can while the consumer keeps consuming
+// the packed variant mirrors the previous layout - all three pointers and the flag in one cache line,
+// with sequentially consistent exchanges standing in for the Interlocked* calls
+
+#include <array>
+#include <thread>
+
+#include "bench_utils.h"
+#include "triple_buffer.h"
+
+template <typename T>
+class packed_triple_buffer {
+	std::array<T, 3> data;
+	struct {
+		T *front_buffer_ptr;
+		T *back_buffer_ptr;
+		std::atomic<T *> middle_buffer_ptr;
+	};
+	std::atomic<int32_t> has_new_data;
+public:
+	packed_triple_buffer() : has_new_data(1)
+	{
+		front_buffer_ptr = &data[2];
+		back_buffer_ptr = &data[0];
+		middle_buffer_ptr = &data[1];
+	}
+	T* get_back_buffer() { return back_buffer_ptr; }
+	void publish()
+	{
+		back_buffer_ptr = middle_buffer_ptr.exchange(back_buffer_ptr);
+		has_new_data.exchange(1);
+	}
+	T* try_consume()
+	{
+		if (has_new_data.exchange(0)) {
+			front_buffer_ptr = middle_buffer_ptr.exchange(front_buffer_ptr);
+			return front_buffer_ptr;
+		}
+		return nullptr;
+	}
+};
+
+struct payload
+{
+    uint64_t seq;
+    uint64_t data[7];
+};
+
+template <typename buffer_t>
+static void run(const char *name, int64_t duration_ns)
+{
+    buffer_t *buffer = new buffer_t();
+    std::atomic<int> running{1};
+    uint64_t num_published = 0;
+
+    std::thread producer([&]() {
+        uint64_t seq = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            payload *p = buffer->get_back_buffer();
+            p->seq = ++seq;
+            for (uint64_t &d : p->data)
+                d = seq;
+            buffer->publish();
+        }
+        num_published = seq;
+    });
+
+    uint64_t num_consumed = 0;
+    uint64_t num_polls = 0;
+    uint64_t num_torn = 0;
+    uint64_t last_seq = 0;
+    const int64_t start = bench_now_ns();
+    while ((bench_now_ns() - start) < duration_ns) {
+        num_polls++;
+        const payload *p = buffer->try_consume();
+        if (p) {
+            num_consumed++;
+            for (uint64_t d : p->data)
+                num_torn += (d != p->seq);
+            num_torn += (p->seq < last_seq);
+            last_seq = p->seq;
+        }
+    }
+    running.store(0);
+    producer.join();
+    const double sec = static_cast<double>(bench_now_ns() - start) * 1e-9;
+
+    printf("%-22s publish %11.0f /s   consume %11.0f /s   poll %11.0f /s   torn %llu\n", name,
+           static_cast<double>(num_published) / sec, static_cast<double>(num_consumed) / sec,
+           static_cast<double>(num_polls) / sec, static_cast<unsigned long long>(num_torn));
+    delete buffer;
+}
+
+int main()
+{
+    constexpr int64_t duration_ns = 2000000000;
+    run<packed_triple_buffer<payload>>("packed, seq_cst", duration_ns);
+    run<triple_buffer<payload>>("padded, acq/rel", duration_ns);
+    return 0;
+}
@@ -0,0 +1,129 @@
+// waveshaper kernels against the SSE loop they replaced, ns per sample of a stereo voice block with the default
+// parameters (9 stages). Every block starts from the same input - shaped in place over and over, it would end up
+// in denormals. The error is the largest difference from the old loop, relative to the output's peak, also with
+// a negative coef_neg
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "bench_utils.h"
+#include "librandom.h"
+#include "waveshaper.h"
+
+static constexpr size_t block_frames = FRAMES_PER_BUFFER;
+
+// the old loop - the coef's fast_atan, a division and the invert mask in every stage of every vector
+static void process_reference(float *samples, size_t num_frames, const dsp::waveshaper::params &p)
+{
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 c_pos = _mm_set1_ps(p.coef_pos);
+    const __m128 c_neg = _mm_set1_ps(p.coef_neg);
+    const __m128i not_mask = _mm_set1_epi32(0xFFFFFFFF);
+    const __m128 pi_4 = _mm_set1_ps(PI_DIV_4);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 a = _mm_set1_ps(0.2447f);
+    const __m128 b = _mm_set1_ps(0.0663f);
+    const __m128 gain = _mm_set1_ps(p.gain);
+    auto fast_atan = [&](__m128 x) {
+        __m128 abs_x = _mm_and_ps(x, abs_mask);
+        __m128 temp = _mm_sub_ps(abs_x, one);
+        temp = _mm_mul_ps(temp, x);
+        x = _mm_mul_ps(x, pi_4);
+        abs_x = _mm_mul_ps(abs_x, b);
+        abs_x = _mm_add_ps(abs_x, a);
+        temp = _mm_mul_ps(temp, abs_x);
+        return _mm_sub_ps(x, temp);
+    };
+    for (size_t i = 0; i < num_frames; i += 4) {
+        __m128 sample = _mm_loadu_ps(samples + i);
+        for (uint32_t j = 0; j < p.num_stages; j++) {
+            __m128i mask = _mm_srai_epi32(_mm_castps_si128(sample), 0x1f);
+            __m128 coef = _mm_and_ps(_mm_castsi128_ps(mask), c_neg);
+            mask = _mm_xor_si128(mask, not_mask);
+            mask = _mm_and_si128(mask, _mm_castps_si128(c_pos));
+            coef = _mm_or_ps(coef, _mm_castsi128_ps(mask));
+            sample = _mm_mul_ps(sample, coef);
+            coef = _mm_div_ps(one, fast_atan(coef));
+            sample = _mm_mul_ps(fast_atan(sample), coef);
+            const uint32_t invert = 0x80000000 & ~((p.invert_stages & j) - 0x01);
+            sample = _mm_xor_ps(sample, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(invert))));
+        }
+        _mm_storeu_ps(samples + i, _mm_mul_ps(sample, gain));
+    }
+}
+
+template <typename F>
+static double time_blocks(F &&process, const std::vector<float> &input, std::vector<float> &work, size_t num_blocks)
+{
+    const int64_t start = bench_now_ns();
+    for (size_t b = 0; b < num_blocks; b++) {
+        memcpy(work.data(), input.data(), sizeof(float) * input.size());
+        process(work.data(), work.size());
+        do_not_optimize(work[0]);
+    }
+    return static_cast<double>(bench_now_ns() - start) / static_cast<double>(num_blocks * input.size());
+}
+
+// the largest difference from the old loop, relative to its output's peak
+static void kernel_errors(const std::vector<float> &input, const dsp::waveshaper::params &p, bool avx2,
+                          float &sse2_err, float &avx2_err)
+{
+    const dsp::waveshaper::stage_constants k = dsp::waveshaper::prepare(p);
+    std::vector<float> ref = input, sse2 = input, fma = input;
+    process_reference(ref.data(), ref.size(), p);
+    dsp::waveshaper::process_sse2(sse2.data(), sse2.size(), k, p);
+    if (avx2)
+        dsp::waveshaper::process_avx2(fma.data(), fma.size(), k, p);
+    float peak = 0.0f;
+    sse2_err = avx2_err = 0.0f;
+    for (size_t i = 0; i < input.size(); i++) {
+        sse2_err = std::max(sse2_err, fabsf(sse2[i] - ref[i]));
+        avx2_err = std::max(avx2_err, fabsf(fma[i] - ref[i]));
+        peak = std::max(peak, fabsf(ref[i]));
+    }
+    sse2_err /= peak;
+    avx2_err /= peak;
+}
+
+int main()
+{
+    constexpr size_t num_blocks = 100000;
+    const dsp::waveshaper::params &p = dsp::waveshaper::default_params;
+    const dsp::waveshaper::stage_constants k = dsp::waveshaper::prepare(p);
+    const bool avx2 = cpu_has_avx2_fma();
+
+    // a stereo block, the channels one after the other
+    std::vector<float> input(block_frames * NUM_CHANNELS);
+    librandom::xoshiro256pp gen(1);
+    for (float &s : input)
+        s = gen.fp_s(1.0f);
+
+    float sse2_err, avx2_err;
+    kernel_errors(input, p, avx2, sse2_err, avx2_err);
+    // the kernels pick the coef and the output constant on the sign of a stage's input, whatever the coefs' signs
+    dsp::waveshaper::params flipped = p;
+    flipped.coef_neg = -p.coef_neg;
+    float flipped_sse2_err, flipped_avx2_err;
+    kernel_errors(input, flipped, avx2, flipped_sse2_err, flipped_avx2_err);
+
+    std::vector<float> work(input.size());
+    const double t_ref = time_blocks([&](float *s, size_t n) { process_reference(s, n, p); }, input, work, num_blocks);
+    const double t_sse2 = time_blocks([&](float *s, size_t n) { dsp::waveshaper::process_sse2(s, n, k, p); }, input,
+                                      work, num_blocks);
+    printf("%10s %12s %12s\n", "kernel", "ns/sample", "error");
+    printf("%10s %10.3fns %12s\n", "old sse", t_ref, "-");
+    printf("%10s %10.3fns %12g\n", "sse2", t_sse2, sse2_err);
+    if (avx2) {
+        const double t_avx2 = time_blocks([&](float *s, size_t n) { dsp::waveshaper::process_avx2(s, n, k, p); },
+                                          input, work, num_blocks);
+        printf("%10s %10.3fns %12g\n", "avx2+fma", t_avx2, avx2_err);
+    } else {
+        puts("no AVX2/FMA on this CPU, the avx2+fma kernel is skipped");
+    }
+    printf("coef_neg < 0, error: sse2 %g", flipped_sse2_err);
+    if (avx2)
+        printf(", avx2+fma %g", flipped_avx2_err);
+    puts("");
+    return 0;
+}
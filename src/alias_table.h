@@ -0,0 +1,72 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// weighted random draws in O(1) - Vose's alias method
+// every column holds its own id with probability prob[i] and an alias for the rest
+class alias_table
+{
+    std::vector<float> _prob;
+    std::vector<uint32_t> _alias;
+
+  public:
+    // false if no weight is positive
+    bool init(const std::vector<float> &weights)
+    {
+        const size_t size = weights.size();
+        assert(size <= UINT32_MAX);
+        double sum = 0.0;
+        for (float w : weights) {
+            sum += (w > 0.0f) ? w : 0.0f;
+        }
+        if (sum <= 0.0) {
+            _prob.clear();
+            _alias.clear();
+            return false;
+        }
+        _prob.resize(size);
+        _alias.resize(size);
+        std::vector<double> scaled(size);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < size; i++) {
+            scaled[i] = ((weights[i] > 0.0f) ? weights[i] : 0.0) * static_cast<double>(size) / sum;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            const uint32_t s = small.back();
+            const uint32_t l = large.back();
+            small.pop_back();
+            large.pop_back();
+            _prob[s] = static_cast<float>(scaled[s]);
+            _alias[s] = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+            (scaled[l] < 1.0 ? small : large).push_back(l);
+        }
+        // whatever is left is 1 up to rounding errors
+        for (uint32_t i : large) {
+            _prob[i] = 1.0f;
+            _alias[i] = i;
+        }
+        for (uint32_t i : small) {
+            _prob[i] = 1.0f;
+            _alias[i] = i;
+        }
+        return true;
+    }
+
+    // rnd - uniformly distributed, at least as wide as the number of ids, coin - uniform in [0, 1)
+    uint32_t draw(uint32_t rnd, float coin) const
+    {
+        assert(!_prob.empty());
+        const size_t column = rnd % _prob.size();
+        return (coin < _prob[column]) ? static_cast<uint32_t>(column) : _alias[column];
+    }
+
+    size_t size() const
+    {
+        return _prob.size();
+    }
+};
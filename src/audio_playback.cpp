@@ -1,19 +1,23 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
+#include <chrono>
+
 #include "audio_playback.h"
 #include "constants.h"
 #include "utils.h"
+#include "wav_file.h"
 #include "profiling.h"
+#include "resampler.h"
 
 #define PA_SAMPLE_TYPE paFloat32
 
 extern int calculate_note_frames(int bpm, int note_length_divisor, const size_t max_lenght_samples, bool no_fadeout);
 
-static librandom::randu random_gen;
-static dsp::filter lp_filter;
+// both owned by the streamer thread, which plans the notes - the file order doesn't depend on the note parameters
+static librandom::xoshiro256pp random_gen;
+static librandom::xoshiro256pp file_random_gen;
 static const dsp::modulation::wavetable w_table;
-static dsp::modulation::lfo lfo_gen{&w_table};
 static const int note_length_divisors[] = { 2, 4, 8, 16 };
 
 static inline float semitones_to_pitch_scale(float semitones_dev)
@@ -22,72 +26,195 @@ static inline float semitones_to_pitch_scale(float semitones_dev)
     return powf(2.0f, semitones / 12.0f);
 }
 
-void pa_data::randomize_data(play_params* params_front_buffer)
+voice_pool::voice_pool() : active_mask(0), note_counter(0)
+{
+    lfo_gen.fill(dsp::modulation::lfo{&w_table});
+}
+
+void voice_pool::init()
+{
+    sample.fill(nullptr);
+    stream.fill(nullptr);
+    num_note_frames.fill(0);
+    resampler.fill(voice_resampler());
+    pitch.fill(1.0f);
+    volume.fill(1.0f);
+    note_id.fill(0);
+    lfo_on_volume.fill(false);
+    filter_tail.fill(false);
+    active_mask = 0;
+    note_counter = 0;
+}
+
+size_t voice_pool::allocate()
 {
-    uparams = params_front_buffer;
-    p_data.pitch = semitones_to_pitch_scale(params_front_buffer->pitch_deviation);
-    p_data.volume = random_gen.fp(params_front_buffer->volume_lower_bound, MAX_VOLUME);
-    const float lpf_freq = random_gen.fp(MAX_LPF_FREQ - params_front_buffer->lpf_freq_range, MAX_LPF_FREQ);
-    const float lpf_q = random_gen.fp(DEFAULT_LPF_Q, DEFAULT_LPF_Q + params_front_buffer->lpf_q_range);
-    lp_filter.setup(lpf_freq, lpf_q);
-    if (!params_front_buffer->randomize_notes_length) {
-        p_data.num_note_frames = params_front_buffer->num_note_frames;
+    size_t voice;
+    if (~active_mask) {
+        voice = bit_scan_forward(~active_mask);
     } else {
-        const int bpm = params_front_buffer->bpm;
-        const int note_length_divisor = note_length_divisors[random_gen.i(_countof(note_length_divisors))];
-        const int max_note_frames = params_front_buffer->max_note_frames;
-        p_data.num_note_frames = calculate_note_frames(bpm, note_length_divisor, max_note_frames, (max_note_frames != INVALID_MAX_FRAMES));
+        // all voices are busy - steal the oldest one
+        voice = 0;
+        for (size_t i = 1; i < MAX_VOICES; i++) {
+            if ((note_counter - note_id[i]) > (note_counter - note_id[voice]))
+                voice = i;
+        }
+        release(voice);
+    }
+    active_mask |= uint64_t(1) << voice;
+    note_id[voice] = note_counter++;
+    return voice;
+}
+
+void seed_random_generators(int64_t seed)
+{
+    random_gen.seed(static_cast<uint64_t>(seed), 0);
+    file_random_gen.seed(static_cast<uint64_t>(seed), 1);
+}
+
+static inline int random_note_frames(const play_params* params)
+{
+    const int bpm = params->bpm;
+    const int note_length_divisor = note_length_divisors[random_gen.i(_countof(note_length_divisors))];
+    const int max_note_frames = params->max_note_frames;
+    return calculate_note_frames(bpm, note_length_divisor, max_note_frames, (max_note_frames != INVALID_MAX_FRAMES));
+}
+
+// a 2-pole low pass or a random filter. The frequency deviation moves a low pass down from MAX_LPF_FREQ and
+// a high pass up from MIN_FILTER_FREQ, the band filters and shelves are spread over the whole band
+static void plan_filter(const play_params *params, note_event &note)
+{
+    using dsp::biquad::filter_type;
+    const float q = random_gen.fp(DEFAULT_LPF_Q, DEFAULT_LPF_Q + params->lpf_q_range);
+    filter_type type = filter_type::low_pass;
+    uint32_t num_sections = 1;
+    if (params->randomize_filter) {
+        type = static_cast<filter_type>(random_gen.i(static_cast<int32_t>(filter_type::count)));
+        num_sections = static_cast<uint32_t>(random_gen.i(1, MAX_FILTER_SECTIONS + 1));
     }
-    if (params_front_buffer->use_lfo) {
-        lfo_gen.set_rate(params_front_buffer->lfo_freq, params_front_buffer->lfo_amount);
+    float freq;
+    float gain_db = 0.0f;
+    switch (type) {
+    case filter_type::low_pass:
+        freq = random_gen.fp(MAX_LPF_FREQ - params->lpf_freq_range, MAX_LPF_FREQ);
+        break;
+    case filter_type::high_pass:
+        freq = random_gen.fp(MIN_FILTER_FREQ, MIN_FILTER_FREQ + params->lpf_freq_range);
+        break;
+    default:
+        freq = BAND_FILTER_MIN_FREQ * powf(BAND_FILTER_MAX_FREQ / BAND_FILTER_MIN_FREQ, random_gen.fp());
+        gain_db = random_gen.fp_s(MAX_SHELF_GAIN_DB);
+        break;
+    }
+    if (params->lfo_on_filter())
+        note.svf_coefs = dsp::filter::compute_modulated(type, num_sections, freq, q, gain_db);
+    else
+        note.lpf_coefs = dsp::filter::compute(type, num_sections, freq, q, gain_db);
+}
+
+void pa_data::trigger_note(const note_event& note)
+{
+    const size_t voice = voices.allocate();
+    voices.sample[voice] = note.source.sample;
+    voices.stream[voice] = note.source.stream;
+    voices.pitch[voice] = note.pitch;
+    voices.volume[voice] = note.volume;
+    voices.num_note_frames[voice] = note.num_note_frames;
+    voices.lfo_on_volume[voice] = note.params.lfo_on_volume();
+    voices.filter_tail[voice] = false;
+    p_data.num_note_frames = note.onset_frames;
+    if (note.params.lfo_on_filter()) {
+        // the filter reads the LFO once per control block
+        voices.lp_filter[voice].set(note.svf_coefs);
+        voices.lfo_gen[voice].set_increment(note.lfo_inc * static_cast<float>(FILTER_CONTROL_FRAMES),
+                                            note.params.lfo_amount);
+    } else {
+        voices.lp_filter[voice].set(note.lpf_coefs);
+        if (note.params.use_lfo)
+            voices.lfo_gen[voice].set_increment(note.lfo_inc, note.params.lfo_amount);
     }
-    p_data.frame_index = 0;
+    voices.resampler[voice].reset();
+}
+
+bool pa_data::render_voice(size_t voice, size_t frames_per_buffer, bool block_filter)
+{
+    voice_resampler &resampler = voices.resampler[voice];
+    const size_t frame_index = resampler.frame();
+    sample_stream *stream = voices.stream[voice];
+    sample_view source;
+    size_t source_offset = frame_index;
+    if (!stream) {
+        source = voices.sample[voice]->view;
+    }
+    const size_t file_frames = stream ? stream->num_frames() : source.num_frames;
+    const size_t note_frames = static_cast<size_t>(voices.num_note_frames[voice]);
+    const size_t total_samples = _min(file_frames, note_frames);
+    const size_t num_file_channels = stream ? stream->num_channels() : source.num_channels;
+    buffer_container &processing_buffer = p_data.processing_buffer;
+    if (frame_index >= total_samples) {
+        // a cascade's pipelined sections still hold the end of the note - a block of silence pushes it out
+        if (!voices.filter_tail[voice]) {
+            return false;
+        }
+        voices.filter_tail[voice] = false;
+        for (size_t ch = 0; ch < num_file_channels; ch++)
+            memset(processing_buffer[ch].data(), 0, sizeof(__m128) * (frames_per_buffer / FP_IN_VEC));
+        voices.lp_filter[voice].process(processing_buffer, num_file_channels, block_filter, voices.lfo_gen[voice]);
+        mix_voice(p_data.mix_buffer, processing_buffer, static_cast<size_t>(num_file_channels > 1),
+                  frames_per_buffer / FP_IN_VEC);
+        return true;
+    }
+    // the streamer is late - hold the position and stay silent for a block, offline renders wait instead
+    if (stream && !stream->view(frame_index, source, source_offset, wait_for_streams)) {
+        return true;
+    }
+    const float pitch = voices.pitch[voice];
+    const size_t out_samples = resampler.frames_until(total_samples, pitch, frames_per_buffer);
+
+    resampler.process(source, source_offset, pitch, processing_buffer, out_samples, frames_per_buffer, num_file_channels,
+                      (total_samples < file_frames), sinc_resampling);
+
+    apply_volume(processing_buffer, num_file_channels, voices.volume[voice], voices.lfo_on_volume[voice],
+                 voices.lfo_gen[voice]);
+
+    if (uparams->waveshaper_enabled)
+        dsp::waveshaper::process(processing_buffer, num_file_channels, dsp::waveshaper::default_params);
+
+    voices.lp_filter[voice].process(processing_buffer, num_file_channels, block_filter, voices.lfo_gen[voice]);
+    voices.filter_tail[voice] = (out_samples + voices.lp_filter[voice].latency() > frames_per_buffer);
+
+    // mono files feed both channels of the mix bus
+    const size_t stereo_file = static_cast<size_t>(source.is_stereo());
+    mix_voice(p_data.mix_buffer, processing_buffer, stereo_file, frames_per_buffer / FP_IN_VEC);
+    return true;
 }
 
 void pa_data::process_audio(float *out_buffer, size_t frames_per_buffer)
 {
+    PROFILE_START("pa_data::process_audio");
     assert((frames_per_buffer & 0x3) == 0x0);
-    const int frame_index = p_data.frame_index;
-    const AudioFile<float> &audio_file = *p_data.audio_file;
-    const int total_samples = _min(audio_file.getNumSamplesPerChannel(), (int)p_data.num_note_frames);
-    const int audio_frames_left = total_samples - frame_index;
-    const size_t num_file_channels = static_cast<size_t>(audio_file.getNumChannels());
-    if (audio_frames_left > 0) {
-        const int out_samples = _min(audio_frames_left, static_cast<int>(frames_per_buffer));
-        const int in_samples = static_cast<int>(static_cast<float>(out_samples) * p_data.pitch);
-        buffer_container &processing_buffer = p_data.processing_buffer;
-
-        const int frames_read = static_cast<int>(resample(
-            audio_file.samples, processing_buffer, static_cast<size_t>(frame_index), static_cast<size_t>(in_samples),
-            static_cast<size_t>(out_samples), frames_per_buffer, num_file_channels,
-            (total_samples < audio_file.getNumSamplesPerChannel())));
-
-        apply_volume(processing_buffer, num_file_channels, p_data.volume, uparams->use_lfo, lfo_gen);
-
-        if (uparams->waveshaper_enabled)
-            dsp::waveshaper::process(processing_buffer, num_file_channels, dsp::waveshaper::default_params);
-
-        lp_filter.process(processing_buffer, num_file_channels);
-
-        const size_t stereo_file = static_cast<size_t>(audio_file.isStereo());
-        for (size_t i = 0; i < frames_per_buffer; i+=4, out_buffer+=FP_IN_VEC*2) {
-            // PA output buffer uses interleaved frame format
-            out_buffer[0] = ((float*)processing_buffer[0].data())[i + 0];
-            out_buffer[1] = ((float*)processing_buffer[stereo_file].data())[i + 0];
-            out_buffer[2] = ((float*)processing_buffer[0].data())[i + 1];
-            out_buffer[3] = ((float*)processing_buffer[stereo_file].data())[i + 1];
-            out_buffer[4] = ((float*)processing_buffer[0].data())[i + 2];
-            out_buffer[5] = ((float*)processing_buffer[stereo_file].data())[i + 2];
-            out_buffer[6] = ((float*)processing_buffer[0].data())[i + 3];
-            out_buffer[7] = ((float*)processing_buffer[stereo_file].data())[i + 3];
+    fill_buffer_with_silence();
+
+    uint64_t active_voices = voices.active_mask;
+    const bool block_filter = (pop_count(active_voices) <= BLOCK_FILTER_MAX_VOICES);
+    while (active_voices) {
+        const size_t voice = bit_scan_forward(active_voices);
+        active_voices &= active_voices - 1;
+        if (!render_voice(voice, frames_per_buffer, block_filter)) {
+            voices.release(voice);
         }
+    }
 
-        p_data.frame_index += frames_read;
-    } else {
-        memset(out_buffer, 0, frames_per_buffer * sizeof(float) * NUM_CHANNELS);    /* left & right */
+    // PA output buffer uses interleaved frame format
+    const __m128 *left = p_data.mix_buffer[0].data();
+    const __m128 *right = p_data.mix_buffer[1].data();
+    for (size_t i = 0, sz = frames_per_buffer / FP_IN_VEC; i < sz; i++, out_buffer += FP_IN_VEC * 2) {
+        _mm_storeu_ps(out_buffer, _mm_unpacklo_ps(left[i], right[i]));
+        _mm_storeu_ps(out_buffer + FP_IN_VEC, _mm_unpackhi_ps(left[i], right[i]));
     }
+
     const int frame_counter = p_data.frame_counter + static_cast<int>(frames_per_buffer);
     p_data.frame_counter = (frame_counter < p_data.num_note_frames) ? frame_counter : 0;
+    PROFILE_STOP("pa_data::process_audio");
 }
 
 int pa_player::init_pa(audio_renderer* renderer)
@@ -110,13 +237,10 @@ int pa_player::init_pa(audio_renderer* renderer)
     err = Pa_OpenStream(&_stream,                           // Pa_OpenDefaultStream
                         NULL,                               /* no input channels */
                         &outputParameters,                  /* stereo output */
-                        SAMPLE_RATE, FRAMES_PER_BUFFER,     /* frames per buffer, i.e. the number
-                                                            of sample frames that PortAudio will
-                                                            request from the callback. Many apps
-                                                            may want to use
-                                                            paFramesPerBufferUnspecified, which
-                                                            tells PortAudio to pick the best,
-                                                            possibly changing, buffer size.*/
+                        SAMPLE_RATE, paFramesPerBufferUnspecified, /* let the host pick its lowest latency,
+                                                            possibly changing, buffer size - the
+                                                            callback rebuffers the fixed-size
+                                                            FRAMES_PER_BUFFER blocks of the renderer.*/
                         paClipOff, audio_renderer::fill_output_buffer, /* this is your callback function */
                         (void *)renderer);                  /*This is a pointer that will be passed to
                                                                  your callback*/
@@ -159,51 +283,67 @@ int pa_player::deinit_pa()
     return paNoError;
 }
 
-bool audio_renderer::init(const char* folder_path, size_t* max_lenght_samples)
+bool audio_renderer::init(const char* folder_path, size_t* max_lenght_samples, size_t cache_size_mb, bool allow_repeats,
+                          bool sinc_resampling)
 {
     data = new pa_data();
     streamer = new audio_streamer();
     params_buffer = new triple_buffer<play_params>();
-    waveform_buffer = new triple_buffer<waveform_data>();
-    waveform_producer = new producer_consumer<waveform_data>();
-    if (!streamer->init(folder_path, max_lenght_samples)) {
+    render_params_buffer = new triple_buffer<play_params>();
+    waveform_taps = new waveform_channel();
+    if (!streamer->init(folder_path, max_lenght_samples, cache_size_mb, allow_repeats)) {
         delete streamer;
         delete data;
         delete params_buffer;
-        delete waveform_buffer;
-        delete waveform_producer;
+        delete render_params_buffer;
+        delete waveform_taps;
         return false;
     }
     static_assert((FRAMES_PER_BUFFER & (FP_IN_VEC - 1)) == 0x0, "Frame buffer size should be divisible by 4.");
     data->resize_processing_buffer(FRAMES_PER_BUFFER);
+    data->sinc_resampling = sinc_resampling;
+    if (sinc_resampling) {
+        resampler::sinc_coefs.init();
+    }
 
     const __m128 zero = _mm_setzero_ps();
     for (auto& buf : buffers) {
         buf.resize(FRAMES_PER_BUFFER * NUM_CHANNELS / FP_IN_VEC, zero);
     }
 
-    zero_out_waveform_data();
-
     return true;
 }
 
 void audio_renderer::start_rendering() 
 {
+    streamer->start(params_buffer);
     render_thread = std::thread(render, this);
 }
 
+void audio_renderer::set_params(const play_params& params)
+{
+    *params_buffer->get_back_buffer() = params;
+    params_buffer->publish();
+    *render_params_buffer->get_back_buffer() = params;
+    render_params_buffer->publish();
+}
+
 void audio_renderer::deinit() 
 {
     state_render.store(0);
+    refill_sem.signal();
     if (render_thread.joinable()) {
         render_thread.join();
     }
+    wakeup_latency.print("Render thread wake-up latency");
+    callback_time.print("Audio callback execution time");
     streamer->deinit();
     delete streamer;
     delete data;
     delete params_buffer;
-    delete waveform_buffer;
-    delete waveform_producer;
+    delete render_params_buffer;
+    waveform_taps->print_stats();
+    delete waveform_taps;
 }
 
 int audio_renderer::fill_output_buffer(const void* input_buffer, void* output_buffer, unsigned long frames_per_buffer,
@@ -212,55 +352,43 @@ int audio_renderer::fill_output_buffer(const void* input_buffer, void* output_bu
 {
     PROFILE_SET_THREAD_NAME("Audio/Submit");
 
-
     PROFILE_FRAME_START("Audio");
     PROFILE_START("audio_renderer::fill_output_buffer");
-    //assert(FRAMES_PER_BUFFER == framesPerBuffer);
-    if (FRAMES_PER_BUFFER != frames_per_buffer) {
-        return paAbort;
-    }
 
     (void)input_buffer; /* Prevent unused variable warnings. */
     (void)time_info;
     (void)status_flags;
 
     audio_renderer* renderer = reinterpret_cast<audio_renderer*>(user_data);
+    const int64_t start_ns = timestamp_ns();
     
+    // the host picks the period size, so the fixed-size rendered blocks are rebuffered here:
+    // each host buffer is filled straight from the queued blocks, a block may span several callbacks
     output_buffer_container* output = nullptr;
-    constexpr size_t buffer_size_bytes = FRAMES_PER_BUFFER * NUM_CHANNELS * sizeof(float);
-    const bool fp_mode = renderer->data->uparams->fp_visualization;
-    const size_t bytes_to_copy = FRAMES_PER_BUFFER * NUM_CHANNELS * (fp_mode ? sizeof(float) : sizeof(int16_t));
-    if (renderer->buffer_queue.try_read(output)) {
-        memcpy(output_buffer, output->data(), buffer_size_bytes); // TODO: check the disassembly
-        // waveform data for the graphics engine
-        renderer->submit_waveform_data(output); // would be better to do this in audio render thread, not in audio callback
-        // waveform data for the fft computer
-        auto* producer = renderer->get_waveform_producer();
-        auto* waveform_buffer = renderer->get_waveform_data_buffer();
-        waveform_data* waveform_data_back_buffer_ptr = waveform_buffer->get_back_buffer();
-        waveform_data& wf_data = producer->begin_producing();
-        memcpy(wf_data.container.data(), waveform_data_back_buffer_ptr->container.data(), bytes_to_copy);
-        wf_data.fp_mode = fp_mode;
-        producer->end_producing();
-        // we publish the waveform data to the graphics thread only after it's been copied to the fft compute buffer
-        waveform_buffer->publish();
-
+    float* out = reinterpret_cast<float*>(output_buffer);
+    size_t frames_left = static_cast<size_t>(frames_per_buffer);
+    while (frames_left) {
+        if (!renderer->buffer_queue.try_read(output)) {
+            memset(out, 0, frames_left * NUM_CHANNELS * sizeof(float));
+            break;
+        }
+        const size_t read_offset = renderer->read_offset;
+        const size_t frames_to_copy = _min(frames_left, FRAMES_PER_BUFFER - read_offset);
+        memcpy(out, reinterpret_cast<const float*>(output->data()) + read_offset * NUM_CHANNELS,
+               frames_to_copy * NUM_CHANNELS * sizeof(float));
+        out += frames_to_copy * NUM_CHANNELS;
+        frames_left -= frames_to_copy;
+        renderer->read_offset = read_offset + frames_to_copy;
+        if (renderer->read_offset < FRAMES_PER_BUFFER) {
+            break; // the host buffer is full, the rest of the block goes to the next callback
+        }
+        renderer->read_offset = 0;
         renderer->buffer_queue.advance();
-    } else {
-        memset(output_buffer, 0, buffer_size_bytes);
-        // zero out waveform_data - would be better to do this in audio render thread, not in audio callback
-        auto* waveform_buffer = renderer->get_waveform_data_buffer();
-        waveform_data* waveform_data_back_buffer_ptr = waveform_buffer->get_back_buffer();
-        memset(waveform_data_back_buffer_ptr->container.data(), 0, bytes_to_copy);
-        waveform_data_back_buffer_ptr->fp_mode = fp_mode;
-        waveform_buffer->publish();
-        // zero out fft data
-        auto* producer = renderer->get_waveform_producer();
-        waveform_data& wf_data = producer->begin_producing();
-        memset(wf_data.container.data(), 0, bytes_to_copy);
-        wf_data.fp_mode = fp_mode;
-        producer->end_producing();
+        // wake up the render thread to refill the slot right away
+        renderer->refill_signal_ns.store(timestamp_ns(), std::memory_order_relaxed);
+        renderer->refill_sem.signal();
     }
+    renderer->callback_time.add(timestamp_ns() - start_ns);
     PROFILE_STOP("audio_renderer::fill_output_buffer");
     PROFILE_FRAME_STOP("Audio");
 
@@ -272,38 +400,98 @@ void audio_renderer::render(void* arg)
     PROFILE_SET_THREAD_NAME("Audio/Render");
 
     audio_renderer &renderer = *(audio_renderer*)arg;
-    static const auto mcs = std::chrono::microseconds(1000);
     while (renderer.state_render.load()) {
-        if (!renderer.buffer_queue.is_full()) {
+        while (!renderer.buffer_queue.is_full()) {
             renderer.process_data();
-        } else {
-            std::this_thread::sleep_for(mcs);
+        }
+        renderer.refill_sem.wait();
+        const int64_t signal_ns = renderer.refill_signal_ns.exchange(0, std::memory_order_relaxed);
+        if (signal_ns) {
+            const int64_t latency_ns = timestamp_ns() - signal_ns;
+            renderer.wakeup_latency.add(latency_ns);
+            PROFILE_PLOT("Render wake-up latency, ns", latency_ns);
         }
     }
 }
 
-void audio_renderer::process_data()
+void audio_renderer::render_block(float* out_buffer)
 {
-    PROFILE_START("audio_renderer::process_data");
+    data->uparams = render_params_buffer->consume();
     if (!data->p_data.frame_counter) {
-        data->p_data.audio_file = streamer->request();
-        assert(data->p_data.audio_file);
-        data->randomize_data(params_buffer->consume());
+        const note_event note = streamer->request();
+        assert(note.source.sample || note.source.stream);
+        data->trigger_note(note);
     }
+    data->process_audio(out_buffer, static_cast<size_t>(FRAMES_PER_BUFFER));
+}
+
+void audio_renderer::process_data()
+{
+    PROFILE_START("audio_renderer::process_data");
     output_buffer_container *output = &buffers[buffer_idx];
-    data->process_audio(reinterpret_cast<float*>(output->data()), static_cast<size_t>(FRAMES_PER_BUFFER));
+    render_block(reinterpret_cast<float*>(output->data()));
+    tap_visualization(output);
     bool res = buffer_queue.try_push(output); res;
     assert(res);
     buffer_idx = ++buffer_idx & (buffers.size() - 1);
     PROFILE_STOP("audio_renderer::process_data");
 }
 
-void audio_renderer::submit_waveform_data(const output_buffer_container* output)
+int audio_renderer::render_offline(const char* path, size_t num_seconds)
+{
+    wav_writer writer;
+    if (!writer.open(path, NUM_CHANNELS, SAMPLE_RATE)) {
+        printf("Failed to open %s for writing.\n", path);
+        return -1;
+    }
+    printf("Rendering %zu seconds to %s...\n", num_seconds, path);
+    // a skipped block would make the output depend on the thread timing
+    data->wait_for_streams = true;
+    streamer->start(params_buffer);
+
+    output_buffer_container& output = buffers[0];
+    float* out_buffer = reinterpret_cast<float*>(output.data());
+    const size_t total_frames = num_seconds * SAMPLE_RATE;
+    std::chrono::nanoseconds engine_time(0);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t frames_done = 0; frames_done < total_frames; frames_done += FRAMES_PER_BUFFER) {
+        const auto block_start = std::chrono::steady_clock::now();
+        render_block(out_buffer);
+        engine_time += std::chrono::steady_clock::now() - block_start;
+        const size_t num_frames = _min(total_frames - frames_done, static_cast<size_t>(FRAMES_PER_BUFFER));
+        if (!writer.write(out_buffer, num_frames)) {
+            printf("Failed writing to %s.\n", path);
+            return -1;
+        }
+    }
+    if (!writer.close()) {
+        printf("Failed finalizing %s.\n", path);
+        return -1;
+    }
+    const std::chrono::duration<double> total_time = std::chrono::steady_clock::now() - start;
+    const double engine_sec = std::chrono::duration<double>(engine_time).count();
+    const double audio_sec = static_cast<double>(num_seconds);
+    printf("Done in %.3f s (engine %.3f s): %.0f frames/s, %.1fx realtime.\n", total_time.count(), engine_sec,
+           static_cast<double>(total_frames) / engine_sec, audio_sec / engine_sec);
+
+    return 0;
+}
+
+void audio_renderer::tap_visualization(const output_buffer_container* output)
+{
+    PROFILE_START("audio_renderer::tap_visualization");
+    // converted once, straight into the channel - every consumer reads the same slot
+    waveform_data& wf_data = waveform_taps->begin_producing();
+    submit_waveform_data(output, wf_data);
+    waveform_taps->end_producing();
+    PROFILE_STOP("audio_renderer::tap_visualization");
+}
+
+void audio_renderer::submit_waveform_data(const output_buffer_container* output, waveform_data& wf_data)
 {
     PROFILE_START("audio_renderer::submit_waveform_data");
 
-    waveform_data* waveform_data_back_buffer_ptr = waveform_buffer->get_back_buffer();
-    waveform_container& container = waveform_data_back_buffer_ptr->container;
+    waveform_container& container = wf_data.container;
     const bool fp_mode = data->uparams->fp_visualization;
     if (!fp_mode) {
         constexpr size_t container_size = FRAMES_PER_BUFFER * NUM_CHANNELS / S16_IN_VEC;
@@ -339,25 +527,26 @@ void audio_renderer::submit_waveform_data(const output_buffer_container* output)
         constexpr size_t buffer_size_bytes = FRAMES_PER_BUFFER * NUM_CHANNELS * sizeof(float);
         memcpy(container.data(), output->data(), buffer_size_bytes);
     }
-    waveform_data_back_buffer_ptr->fp_mode = fp_mode;
+    wf_data.fp_mode = fp_mode;
 
     PROFILE_STOP("audio_renderer::submit_waveform_data");
 }
 
-bool audio_streamer::init(const char* folder_path, size_t* max_lenght_samples)
+bool audio_streamer::init(const char* folder_path, size_t* max_lenght_samples, size_t cache_size_mb, bool allow_repeats)
 {
-    if (!load_file_names(folder_path, max_lenght_samples)) {
-        return false;
-    }
+    this->allow_repeats = allow_repeats;
+    samples.init(cache_size_mb << 20);
+    return load_file_names(folder_path, max_lenght_samples);
+}
 
-    // push the file batch of files right away
-    for (const auto &_ : audio_files) {
-        load_file();
+void audio_streamer::start(triple_buffer<play_params>* params)
+{
+    params_buffer = params;
+    // the first batch of notes is ready right away
+    while (!note_queue.is_full()) {
+        plan_note();
     }
-
     streamer_thread = std::thread(stream, this);
-
-    return true;
 }
 
 void audio_streamer::deinit()
@@ -367,14 +556,23 @@ void audio_streamer::deinit()
     if (streamer_thread.joinable()) {
         streamer_thread.join();
     }
+    samples.print_stats();
+    uint32_t underruns = 0;
+    for (const sample_stream& stream : streams) {
+        underruns += stream.underruns();
+    }
+    printf("Streamed voices: %u blocks skipped waiting for the disk\n", underruns);
 }
 
-AudioFile<float>* audio_streamer::request()
+note_event audio_streamer::request()
 {
-    AudioFile<float>* file = nullptr;
-    file_queue.try_pop(file);
-    sem.signal(); // signal to load the next file
-    return file;
+    note_event note;
+    while (!note_queue.try_pop(note)) {
+        // the streamer fell behind, which is expected when rendering faster than realtime
+        std::this_thread::yield();
+    }
+    sem.signal(); // signal to plan the next note
+    return note;
 }
 
 void audio_streamer::stream(void* arg)
@@ -384,8 +582,9 @@ void audio_streamer::stream(void* arg)
     audio_streamer* streamer = (audio_streamer*)arg;
 
     while (streamer->state_streaming.load()) {
-        if (streamer->file_queue.is_empty()) {
-            streamer->load_file();
+        streamer->service_streams();
+        if (!streamer->note_queue.is_full()) {
+            streamer->plan_note();
         } else {
             streamer->sem.wait();
         }
@@ -394,61 +593,120 @@ void audio_streamer::stream(void* arg)
 
 size_t audio_streamer::get_rnd_file_id() 
 {
-    const int num_files = static_cast<int>(file_names.size());
-    uint32_t rnd_id = static_cast<uint32_t>(random_gen.i(num_files - 1));
-    cache cache(cache_id);
-    rnd_id = cache.check(rnd_id, static_cast<uint8_t>(num_files));
-    cache_id = cache.value();
-    return static_cast<const size_t>(rnd_id);
+    const uint32_t num_files = static_cast<uint32_t>(file_names.size());
+    uint32_t file_id;
+    if (weighted_file_picker.size()) {
+        file_id = weighted_file_picker.draw(file_random_gen.u32(), file_random_gen.fp());
+        // a weighted cycle doesn't exist, so "no repeats" only means no file twice in a row -
+        // give up after a few tries, the weights might leave hardly anything else
+        for (int i = 0; i < 8 && !allow_repeats && file_id == last_file_id && num_files > 1; i++) {
+            file_id = weighted_file_picker.draw(file_random_gen.u32(), file_random_gen.fp());
+        }
+    } else if (allow_repeats) {
+        file_id = file_random_gen.u32() % num_files;
+    } else {
+        file_id = file_picker.draw(file_random_gen.u32());
+    }
+    last_file_id = file_id;
+    return static_cast<size_t>(file_id);
 }
 
-void audio_streamer::load_file() 
+void audio_streamer::plan_note() 
 {
-    PROFILE_START("audio_streamer::load_file");
-    AudioFile<float>& audio_file = audio_files[buffer_idx];
+    PROFILE_START("audio_streamer::plan_note");
+    note_event note;
     const size_t file_id = get_rnd_file_id();
-    bool res = audio_file.load(file_names[file_id]); res;
-    assert(res);
-    res = file_queue.try_push(&audio_file);
+    if (file_streamed[file_id]) {
+        note.source.stream = open_stream(file_id);
+    } else {
+        // only a miss touches the disk, the queue's reference passes on to the voice
+        note.source.sample = samples.acquire(file_id, file_names[file_id], file_sizes[file_id]);
+    }
+
+    const play_params* params = params_buffer->consume();
+    note.params = *params;
+    note.pitch = semitones_to_pitch_scale(params->pitch_deviation);
+    note.volume = random_gen.fp(params->volume_lower_bound, MAX_VOLUME);
+    plan_filter(params, note);
+    if (!params->randomize_notes_length) {
+        note.onset_frames = params->num_note_frames;
+        note.num_note_frames = note.onset_frames;
+    } else {
+        // onset spacing and note length are drawn independently, so long notes overlap the following ones
+        note.onset_frames = random_note_frames(params);
+        note.num_note_frames = random_note_frames(params);
+    }
+    note.lfo_inc = dsp::modulation::lfo::increment(params->lfo_freq);
+
+    bool res = note_queue.try_push(note); res;
     assert(res);
-    buffer_idx = ++buffer_idx & (audio_files.size() - 1);
-    PROFILE_STOP("audio_streamer::load_file");
+    PROFILE_STOP("audio_streamer::plan_note");
+}
 
+sample_stream* audio_streamer::open_stream(size_t file_id)
+{
+    // there's a stream for every voice and queued note, so one of them is always free
+    for (sample_stream& stream : streams) {
+        if (!stream.in_use()) {
+            bool res = stream.open(file_names[file_id], &sem); res;
+            assert(res);
+            return &stream;
+        }
+    }
+    assert(false);
+    return nullptr;
+}
+
+void audio_streamer::service_streams()
+{
+    for (sample_stream& stream : streams) {
+        stream.service();
+    }
 }
 
 bool audio_streamer::load_file_names(const char* folder_path, size_t* max_lenght_samples)
 {
-    char path[MAX_PATH];
-    memset(path, 0, sizeof(path));
-    strcpy_s(path, folder_path);
-    strcat_s(path, "\\*.wav");
+    std::vector<library_entry> library;
+    if (!scan_library(folder_path, library)) {
+        return false;
+    }
+    std::unordered_map<std::string, float> library_weights;
+    const bool weighted = read_library_weights(folder_path, library_weights);
+    std::vector<float> weights;
 
     size_t max_size = 0;
-
-    WIN32_FIND_DATA fd;
-    HANDLE h_find = ::FindFirstFile(path, &fd);
-    if (h_find != INVALID_HANDLE_VALUE) {
-        do {
-            if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-                memset(path, 0, sizeof(path));
-                strcpy_s(path, folder_path);
-                strcat_s(path, "\\");
-                strcat_s(path, fd.cFileName);
-
-                AudioFile<float> audio_file;
-                audio_file.load(path);
-                // check size
-                const size_t num_samples = audio_file.getNumSamplesPerChannel();
-                const size_t size = num_samples * audio_file.getNumChannels() * sizeof(float); // for fp32 wav format
-                if (size < MAX_DATA_SIZE) {
-                    file_names.push_back(std::string(path));
-                    max_size = _max(num_samples, max_size);
-                }
-            }
-        } while (::FindNextFile(h_find, &fd));
-        ::FindClose(h_find);
-        *max_lenght_samples = max_size;
-        return !!file_names.size();
-    }
-    return false;
+    char path[MAX_PATH];
+    for (const library_entry& entry : library) {
+        const wav_info& info = entry.info;
+        if (!info.is_decodable()) {
+            continue;
+        }
+        // check size
+        const size_t num_samples = info.num_frames;
+        const size_t size = num_samples * info.num_channels * sizeof(float); // decoded to fp32
+        const bool streamed = (size >= MAX_DATA_SIZE);
+        if (streamed && !info.is_mappable()) {
+            continue; // only mappable files can be streamed
+        }
+        memset(path, 0, sizeof(path));
+        strcpy_s(path, folder_path);
+        strcat_s(path, "\\");
+        strcat_s(path, entry.name.c_str());
+        file_names.push_back(std::string(path));
+        file_sizes.push_back(size);
+        file_streamed.push_back(streamed);
+        max_size = _max(num_samples, max_size);
+        if (weighted) {
+            // files without a weight keep the default one
+            auto it = library_weights.find(entry.name);
+            weights.push_back((it != library_weights.end()) ? it->second : 1.0f);
+        }
+    }
+    *max_lenght_samples = max_size;
+    samples.resize(file_names.size());
+    file_picker.init(file_names.size());
+    if (weighted && !weighted_file_picker.init(weights)) {
+        puts("All the file weights are zero - picking the files uniformly.");
+    }
+    return !!file_names.size();
 }
\ No newline at end of file
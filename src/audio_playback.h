@@ -1,39 +1,72 @@
 #pragma once
 
 #include <array>
+#include <thread>
 
 #include "AudioFile.h"
 #include "portaudio.h"
+#include "alias_table.h"
 #include "audio_processing.h"
-#include "cache.h"
 #include "circular_buffer.h"
+#include "librandom.h"
+#include "sample_cache.h"
+#include "sample_library.h"
+#include "sample_stream.h"
 #include "semaphore.h"
+#include "shuffle_bag.h"
 #include "triple_buffer.h"
-#include "producer_consumer.h"
+#include "timing.h"
+
+// per-voice state is kept in parallel arrays, so that mixing a dense texture walks contiguous memory
+struct voice_pool
+{
+    static_assert(MAX_VOICES <= 64, "Voice activity is tracked in a 64-bit mask.");
+
+    std::array<const cached_sample *, MAX_VOICES> sample; // referenced while the voice plays
+    std::array<sample_stream *, MAX_VOICES> stream; // instead of a sample, for files too long to keep resident
+    std::array<voice_resampler, MAX_VOICES> resampler; // read position
+    std::array<int, MAX_VOICES> num_note_frames;
+    std::array<float, MAX_VOICES> pitch;
+    std::array<float, MAX_VOICES> volume;
+    std::array<uint32_t, MAX_VOICES> note_id; // trigger order - the oldest voice gets stolen
+    std::array<dsp::filter, MAX_VOICES> lp_filter;
+    std::array<dsp::modulation::lfo, MAX_VOICES> lfo_gen;
+    std::array<bool, MAX_VOICES> lfo_on_volume; // the note's routing, a swept filter has it in its coefficients
+    std::array<bool, MAX_VOICES> filter_tail; // the filter's latency pushed the end of the note past the last block
+    uint64_t active_mask;
+    uint32_t note_counter;
+
+    voice_pool();
+
+    void init();
+    size_t allocate();
+    void release(size_t voice)
+    {
+        active_mask &= ~(uint64_t(1) << voice);
+        if (sample[voice])
+            sample_cache::release(sample[voice]);
+        if (stream[voice])
+            stream[voice]->release();
+        sample[voice] = nullptr;
+        stream[voice] = nullptr;
+    }
+};
 
 struct play_data
 {
-    const AudioFile<float> *audio_file;
-    buffer_container processing_buffer;
-    int frame_index;
+    buffer_container processing_buffer; // scratch buffer for the voice being rendered
+    buffer_container mix_buffer;
     int frame_counter;
-    float pitch;
-    float volume;
-    int num_note_frames;
-    // 4 bytes padding
+    int num_note_frames; // frames between two note onsets
+    // 0 bytes padding
 
-    play_data()
-        : audio_file(nullptr), frame_index(0), frame_counter(0), pitch(1.0f), volume(1.0f),
-          num_note_frames(0)
+    play_data() : frame_counter(0), num_note_frames(0)
     {
     }
 
     void init()
     {
-        pitch = 1.0f;
-        volume = 1.0f;
         num_note_frames = 0;
-        frame_index = 0;
         frame_counter = 0;
     }
 };
@@ -53,8 +86,11 @@ struct play_params
     bool waveshaper_enabled;
     bool fp_visualization;
     bool randomize_notes_length;
+    bool randomize_filter; // type and number of sections, otherwise a 2-pole low pass
+    bool lfo_filter; // the LFO sweeps the filter cutoff instead of the volume
 
-    void init(int nsf, int mnf, float pd, float vlb, float lfr, float lqr, float lf, float la, float bpm, bool ul, bool we, bool fpv, bool rnl)
+    void init(int nsf, int mnf, float pd, float vlb, float lfr, float lqr, float lf, float la, float bpm, bool ul, bool we, bool fpv, bool rnl,
+              bool rf, bool lflt)
     {
         num_note_frames = nsf;
         max_note_frames = mnf;
@@ -69,17 +105,45 @@ struct play_params
         waveshaper_enabled = we;
         fp_visualization = fpv;
         randomize_notes_length = rnl;
+        randomize_filter = rf;
+        lfo_filter = lflt;
+    }
+    bool lfo_on_volume() const
+    {
+        return use_lfo && !lfo_filter;
+    }
+    bool lfo_on_filter() const
+    {
+        return use_lfo && lfo_filter;
     }
 };
 
+// everything a note needs, drawn ahead of time by the streamer thread - the render thread only copies it into a voice
+struct note_event
+{
+    dsp::filter::coefs lpf_coefs;
+    dsp::filter::modulated_coefs svf_coefs; // instead of lpf_coefs, when the LFO is on the filter
+    play_params params; // the parameters the note was planned with
+    note_source source;
+    float pitch;
+    float volume;
+    float lfo_inc;
+    int num_note_frames; // how long the voice plays
+    int onset_frames; // until the next note
+};
+
 struct pa_data
 {
+    voice_pool voices;
     play_data p_data;
-    const play_params* uparams;
+    const play_params* uparams; // the latest ones, for the global toggles - notes carry their own
+    bool sinc_resampling; // for the whole session
+    bool wait_for_streams; // offline rendering - a late stream holds up the block instead of skipping it
 
-    pa_data() : uparams(nullptr)
+    pa_data() : uparams(nullptr), sinc_resampling(false), wait_for_streams(false)
     {
         p_data.init();
+        voices.init();
     }
 
     // C5220
@@ -92,19 +156,26 @@ struct pa_data
     {
         assert((num_frames & (FP_IN_VEC - 1)) == 0x0);
         num_frames /= FP_IN_VEC;
-        p_data.processing_buffer[0].resize(num_frames);
-        p_data.processing_buffer[1].resize(num_frames);
+        for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+            p_data.processing_buffer[ch].resize(num_frames);
+            p_data.mix_buffer[ch].resize(num_frames);
+        }
     }
     void fill_buffer_with_silence()
     {
-        const size_t size = p_data.processing_buffer[0].size();
-        memset(p_data.processing_buffer[0].data(), 0, sizeof(__m128) * size);
-        memset(p_data.processing_buffer[1].data(), 0, sizeof(__m128) * size);
+        const size_t size = p_data.mix_buffer[0].size();
+        memset(p_data.mix_buffer[0].data(), 0, sizeof(__m128) * size);
+        memset(p_data.mix_buffer[1].data(), 0, sizeof(__m128) * size);
     }
-    void randomize_data(play_params* params_front_buffer);
+    void trigger_note(const note_event& note);
     void process_audio(float* out_buffer, size_t frames_per_buffer);
+private:
+    bool render_voice(size_t voice, size_t frames_per_buffer, bool block_filter);
 };
 
+// render and streamer threads draw from separate generators - seed before audio_renderer::init
+void seed_random_generators(int64_t seed);
+
 class audio_renderer; // FWD
 
 class pa_player
@@ -126,72 +197,75 @@ class audio_renderer
 {
     pa_data* data = nullptr;
     audio_streamer* streamer = nullptr;
-    triple_buffer<play_params> *params_buffer = nullptr;
-    // ouput to graphics engine
-    triple_buffer<waveform_data> *waveform_buffer = nullptr;
-    // output to fft computer
-    producer_consumer<waveform_data> *waveform_producer = nullptr; // producer for waveform_consumer
+    triple_buffer<play_params> *params_buffer = nullptr; // to the streamer, for the notes it plans
+    triple_buffer<play_params> *render_params_buffer = nullptr; // to the render thread, for the global toggles
+    // output to the graphics engine and the fft computer
+    waveform_channel *waveform_taps = nullptr;
 
     std::array<output_buffer_container, (1 << NUM_BUFFERS_POW_2)> buffers;
     size_t buffer_idx = 0;
     circular_buffer<output_buffer_container*, NUM_BUFFERS_POW_2> buffer_queue; // thread-safe
+    size_t read_offset = 0; // frames of the head block already sent to the device, callback only
     std::thread render_thread;
     std::atomic<int> state_render{1};
+    semaphore refill_sem; // signaled by the callback each time it consumes a buffer
+    std::atomic<int64_t> refill_signal_ns{0};
+    timing_stats wakeup_latency; // callback signal -> render thread running, render thread only
+    timing_stats callback_time; // callback only
 public:
-    bool init(const char* folder_path, size_t* max_lenght_samples);
+    bool init(const char* folder_path, size_t* max_lenght_samples, size_t cache_size_mb, bool allow_repeats,
+              bool sinc_resampling);
     void start_rendering();
     void deinit();
+    // headless faster-than-realtime rendering, bypasses the render thread and PortAudio
+    int render_offline(const char* path, size_t num_seconds);
     pa_data* get_data() { return data; }
-    triple_buffer<play_params> *get_params_buffer() { return params_buffer; }
-    triple_buffer<waveform_data> *get_waveform_data_buffer() { return waveform_buffer; }
-    producer_consumer<waveform_data> *get_waveform_producer() { return waveform_producer; }
+    // main thread - the notes planned from now on and the next rendered block pick them up
+    void set_params(const play_params& params);
+    waveform_channel *get_waveform_channel() { return waveform_taps; }
 
     static int fill_output_buffer(const void* input_buffer, void* output_buffer, unsigned long frames_per_buffer,
                             const PaStreamCallbackTimeInfo* time_info, PaStreamCallbackFlags status_flags,
                             void* user_data);
 private:
     static void render(void* renderer);
+    void render_block(float* out_buffer);
     void process_data();
-    void zero_out_waveform_data()
-    {
-        for (int i = 0; i < 3; i++) {
-            waveform_container &data = waveform_buffer->get_data((size_t)i)->container;
-            memset(data.data(), 0, sizeof(float) * VIZ_BUFFER_SIZE);
-        }
-        for (int i = 0; i < 2; i++) {
-            waveform_producer->init_data([](void* a, void* b) 
-                {   
-                    waveform_data* a_ptr = (waveform_data*)a;
-                    waveform_data* b_ptr = (waveform_data*)a;
-                    memset(a_ptr->container.data(), 0, sizeof(float) * a_ptr->container.size());
-                    memset(b_ptr->container.data(), 0, sizeof(float) * b_ptr->container.size());
-                    a_ptr->fp_mode = false;
-                    b_ptr->fp_mode = false;
-                });
-        }
-    }
-    void submit_waveform_data(const output_buffer_container *output);
+    // visualization tap - runs on the render thread, so that the callback is left with a single copy
+    void tap_visualization(const output_buffer_container *output);
+    void submit_waveform_data(const output_buffer_container *output, waveform_data &wf_data);
 };
 
 class audio_streamer
 {
     std::vector<std::string> file_names;
-    audio_file_container audio_files;
-    size_t buffer_idx = 0;
-    circular_buffer<AudioFile<float>*, NUM_FILES_POW_2> file_queue;
-    uint32_t cache_id = 0;
+    std::vector<size_t> file_sizes; // as fp32 frames, bytes - what the cache charges, decoded or mapped
+    std::vector<bool> file_streamed; // too long to keep resident
+    sample_cache samples;
+    std::array<sample_stream, MAX_STREAMS> streams;
+    circular_buffer<note_event, NOTE_QUEUE_POW_2> note_queue;
+    triple_buffer<play_params> *params_buffer = nullptr; // consumed here, notes carry a copy
+    shuffle_bag file_picker;
+    alias_table weighted_file_picker; // only if the library comes with weights
+    uint32_t last_file_id = UINT32_MAX;
+    bool allow_repeats = false;
     std::thread streamer_thread;
     semaphore sem;
     std::atomic<int> state_streaming{1};
 
 public:
-    audio_streamer() : cache_id(0) {}
-    bool init(const char* folder_path, size_t* max_lenght_samples);
+    audio_streamer() {}
+    bool init(const char* folder_path, size_t* max_lenght_samples, size_t cache_size_mb, bool allow_repeats);
+    // planning needs the playback parameters, so it begins only once they're set
+    void start(triple_buffer<play_params>* params);
     void deinit();
-    AudioFile<float>* request();
+    // the note's sample stays resident until sample_cache::release(), a stream is kept until sample_stream::release()
+    note_event request();
 private:
     static void stream(void* arg);
     size_t get_rnd_file_id();
-    void load_file();
+    void plan_note();
+    sample_stream* open_stream(size_t file_id);
+    void service_streams();
     bool load_file_names(const char* folder_path, size_t* max_lenght_samples);
 };
\ No newline at end of file
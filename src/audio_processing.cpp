@@ -1,5 +1,6 @@
 #include "audio_processing.h"
 #include "profiling.h"
+#include "resampler.h"
 
 inline void apply_fadeout(float *dest, size_t out_samples)
 {
@@ -14,56 +15,62 @@ inline void apply_fadeout(float *dest, size_t out_samples)
     }
 }
 
-size_t resample(const AudioFile<float>::AudioBuffer &source, buffer_container &destination, size_t file_offset, size_t in_samples,
-             size_t out_samples, size_t frames_per_buffer, size_t num_ch, bool fadeout)
+size_t voice_resampler::frames_until(size_t end_frame, float step, size_t max_frames) const
+{
+    if (end_frame <= _frame)
+        return 0;
+    const double frames = ceil((static_cast<double>(end_frame - _frame) - _phase) / static_cast<double>(step));
+    return (frames < static_cast<double>(max_frames)) ? static_cast<size_t>(frames) : max_frames;
+}
+
+void voice_resampler::process(const sample_view &source, size_t source_offset, float step, buffer_container &destination,
+                              size_t num_frames, size_t frames_per_buffer, size_t num_ch, bool fadeout, bool sinc)
 {
     float *dest[NUM_CHANNELS];
     dest[0] = (float *)destination[0].data();
     dest[1] = (float *)destination[1].data();
-    size_t frames_read = in_samples;
 
-    PROFILE_START("resample");
+    PROFILE_START("voice_resampler::process");
 
-    if (in_samples == out_samples) {
-        // common case - just copy and attenuate
-        for (size_t ch = 0; ch < num_ch; ch++) {
-            memcpy(dest[ch], (const void *)(source[ch].data() + file_offset), sizeof(float) * out_samples);
-            // if it's the last one - pad with zeros
-            if (out_samples < frames_per_buffer) {
-                if (fadeout)
-                    apply_fadeout(dest[ch], out_samples);
-                memset(dest[ch], 0, sizeof(float) * (frames_per_buffer - out_samples));
+    const float phase = static_cast<float>(_phase);
+    for (size_t ch = 0; ch < num_ch; ch++) {
+        size_t written = num_frames;
+        if (step == 1.0f && _phase == 0.0) {
+            // common case - just copy
+            written = (source_offset < source.num_frames) ? (source.num_frames - source_offset) : 0;
+            written = (written < num_frames) ? written : num_frames;
+            if (source.is_planar()) {
+                memcpy(dest[ch], (const void *)(source.channels[ch] + source_offset * source.stride), sizeof(float) * written);
+            } else {
+                for (size_t i = 0; i < written; i++)
+                    dest[ch][i] = source.at(ch, source_offset + i);
             }
+        } else if (sinc) {
+            written = resampler::sinc(source.channels[ch], source.stride, source.num_frames, source_offset, step, phase,
+                                      dest[ch], 0, num_frames);
+        } else {
+            // everything up to the end of the source is interpolated in one go, no bounds check per sample
+            written = resampler::linear_safe_end(source_offset, step, phase, source.num_frames, 0, num_frames);
+            resampler::linear(source.channels[ch], source.stride, source_offset, step, phase, dest[ch], 0, written);
         }
-    } else {
-        const float d = float(in_samples) / float(out_samples);
-        for (size_t ch = 0; ch < num_ch; ch++) {
-            dest[ch][0] = source[ch][file_offset];
-            for (size_t i = 1, j = file_offset + 1, sz = source[ch].size(); i < out_samples; i++) {
-                const float x = float(i) * d;
-                const int y = int(x);
-                const float z = x - float(y);
-                assert(static_cast<size_t>(y) < in_samples);
-                const size_t idx = j + static_cast<size_t>(y);
-                if ((idx + 1) >= sz)
-                    break;
-                const float res = source[ch][idx] * (1.0f - z) + source[ch][idx + 1] * z;
-                dest[ch][i] = res;
-            }
-            // if it's the last one - pad with zeros
-            if (out_samples < frames_per_buffer) {
-                if (fadeout)
-                    apply_fadeout(dest[ch], out_samples);
-                memset(dest[ch], 0, sizeof(float) * (frames_per_buffer - out_samples));
-                if ((out_samples < frames_per_buffer) && (d < 1.0f))
-                    frames_read = out_samples;
-            }
+        // the processing buffer is shared between the voices - don't leave stale samples behind
+        if (written < num_frames)
+            memset(dest[ch] + written, 0, sizeof(float) * (num_frames - written));
+        // if it's the last one - pad with zeros
+        if (num_frames < frames_per_buffer) {
+            if (fadeout)
+                apply_fadeout(dest[ch], num_frames);
+            memset(dest[ch] + num_frames, 0, sizeof(float) * (frames_per_buffer - num_frames));
         }
     }
 
-    PROFILE_STOP("resample");
+    // in double - a float position would lose the fraction on long files
+    const double position = _phase + static_cast<double>(num_frames) * static_cast<double>(step);
+    const double whole = floor(position);
+    _frame += static_cast<size_t>(whole);
+    _phase = position - whole;
 
-    return frames_read;
+    PROFILE_STOP("voice_resampler::process");
 }
 
 void apply_volume(buffer_container &buffer, size_t num_channels, float volume, bool use_lfo,
@@ -90,6 +97,18 @@ void apply_volume(buffer_container &buffer, size_t num_channels, float volume, b
     }
 }
 
+void mix_voice(buffer_container &mix, const buffer_container &voice, size_t stereo_voice, size_t num_vectors)
+{
+    const __m128 *src_l = voice[0].data();
+    const __m128 *src_r = voice[stereo_voice].data();
+    __m128 *dst_l = mix[0].data();
+    __m128 *dst_r = mix[1].data();
+    for (size_t i = 0; i < num_vectors; i++) {
+        dst_l[i] = _mm_add_ps(dst_l[i], src_l[i]);
+        dst_r[i] = _mm_add_ps(dst_r[i], src_r[i]);
+    }
+}
+
 int calculate_note_frames(int bpm, int note_length_divisor, const size_t max_lenght_samples, bool no_fadeout)
 {
     int note_frames;
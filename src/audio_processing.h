@@ -1,9 +1,38 @@
 #pragma once
 
 #include "dsp.h"
+#include "sample_cache.h"
 
-size_t resample(const AudioFile<float>::AudioBuffer &source, buffer_container &dest, size_t file_offset,
-                size_t in_samples, size_t out_samples, size_t frames_per_buffer, size_t num_ch, bool fadeout);
+// a voice's read position in its source - the fraction carries over from block to block, so the pitch can change
+// every block without the position drifting
+class voice_resampler
+{
+    size_t _frame; // integer part of the read position
+    double _phase; // fractional part, [0, 1)
+
+  public:
+    voice_resampler() : _frame(0), _phase(0.0)
+    {
+    }
+    void reset()
+    {
+        _frame = 0;
+        _phase = 0.0;
+    }
+    size_t frame() const
+    {
+        return _frame;
+    }
+    // outputs until the read position reaches end_frame, at most max_frames
+    size_t frames_until(size_t end_frame, float step, size_t max_frames) const;
+    // one block of num_frames outputs at step source frames per output, then advances the read position.
+    // frame() is at source_offset of the view - they differ for streams. The buffer is padded with zeros
+    // up to frames_per_buffer, sinc needs resampler::sinc_coefs initialized
+    void process(const sample_view &source, size_t source_offset, float step, buffer_container &dest, size_t num_frames,
+                 size_t frames_per_buffer, size_t num_ch, bool fadeout, bool sinc);
+};
 
 void apply_volume(buffer_container &buffer, size_t num_channels, float volume, bool use_lfo,
-                  dsp::modulation::lfo &lfo_gen);
\ No newline at end of file
+                  dsp::modulation::lfo &lfo_gen);
+
+void mix_voice(buffer_container &mix, const buffer_container &voice, size_t stereo_voice, size_t num_vectors);
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "constants.h"
+#include "semaphore.h"
+
+// lock-free single producer / multiple consumers broadcast
+// the producer writes each message once into a ring of slots and never waits for the readers,
+// every consumer reads the slots in place through its own cursor. A slot carries a sequence stamp (seqlock),
+// so a reader that got lapped while reading finds out in end_consuming() and the message is counted as dropped.
+template <typename T, size_t sz_pow_2, size_t max_consumers>
+class broadcast_channel
+{
+    static constexpr uint64_t capacity = uint64_t(1) << sz_pow_2;
+    static constexpr uint64_t mask = capacity - 1;
+
+    static_assert(capacity > 1, "At least two slots are required.");
+
+    struct alignas(CACHE_LINE_SIZE) slot
+    {
+        std::atomic<uint64_t> stamp{0}; // 2 * (seq + 1) once message seq is complete, odd while it's being written
+        T value;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) consumer
+    {
+        uint64_t read_seq = 0;    // next message in order
+        uint64_t reading_seq = 0; // message between begin_* and end_consuming
+        std::atomic<uint64_t> dropped{0};
+        const char *name = nullptr;
+        bool blocking = false;
+        semaphore sem;
+    };
+
+    std::array<slot, capacity> slots;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> write_seq{0}; // number of complete messages
+    std::atomic<uint32_t> num_consumers{0};
+    std::array<consumer, max_consumers> consumers;
+
+  public:
+    broadcast_channel() = default;
+
+    // C5220
+    broadcast_channel(const broadcast_channel &) = delete;
+    broadcast_channel &operator=(const broadcast_channel &) = delete;
+
+    // setup - has to happen before the producer starts
+    size_t add_consumer(const char *name, bool blocking)
+    {
+        const uint32_t id = num_consumers.load(std::memory_order_relaxed);
+        assert(id < max_consumers);
+        consumers[id].name = name;
+        consumers[id].blocking = blocking;
+        num_consumers.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // producer
+    T &begin_producing()
+    {
+        const uint64_t seq = write_seq.load(std::memory_order_relaxed);
+        slot &s = slots[seq & mask];
+        s.stamp.store(2 * seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return s.value;
+    }
+    void end_producing()
+    {
+        const uint64_t seq = write_seq.load(std::memory_order_relaxed);
+        slots[seq & mask].stamp.store(2 * seq + 2, std::memory_order_release);
+        write_seq.store(seq + 1, std::memory_order_release);
+        for (uint32_t i = 0, sz = num_consumers.load(std::memory_order_acquire); i < sz; i++) {
+            if (consumers[i].blocking)
+                consumers[i].sem.signal();
+        }
+    }
+
+    // consumers - the next message in order, skips ahead if the producer lapped the cursor
+    const T *try_begin_consuming(size_t id)
+    {
+        consumer &c = consumers[id];
+        for (;;) {
+            const uint64_t latest = write_seq.load(std::memory_order_acquire);
+            if (c.read_seq == latest) {
+                return nullptr;
+            }
+            if ((latest - c.read_seq) >= capacity) {
+                const uint64_t oldest = latest - capacity + 1;
+                c.dropped.fetch_add(oldest - c.read_seq, std::memory_order_relaxed);
+                c.read_seq = oldest;
+            }
+            const uint64_t seq = c.read_seq++;
+            const T *value = begin_reading(c, seq);
+            if (value) {
+                return value;
+            }
+            c.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // blocks until there is a message, returns nullptr if woken up without one
+    const T *begin_consuming(size_t id)
+    {
+        const T *value = try_begin_consuming(id);
+        if (value) {
+            return value;
+        }
+        consumers[id].sem.wait();
+        return try_begin_consuming(id);
+    }
+    // the newest message, even if it was seen before - for views that only care about the current state
+    const T *begin_reading_latest(size_t id)
+    {
+        consumer &c = consumers[id];
+        const uint64_t latest = write_seq.load(std::memory_order_acquire);
+        if (!latest) {
+            return nullptr;
+        }
+        c.read_seq = latest;
+        return begin_reading(c, latest - 1);
+    }
+    // false if the message got overwritten while it was being read
+    bool end_consuming(size_t id)
+    {
+        consumer &c = consumers[id];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t stamp = slots[c.reading_seq & mask].stamp.load(std::memory_order_relaxed);
+        if (stamp != (2 * c.reading_seq + 2)) {
+            c.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    // wakes up a blocked consumer, e.g. on shutdown
+    void wake(size_t id)
+    {
+        consumers[id].sem.signal();
+    }
+
+    uint64_t dropped(size_t id) const
+    {
+        return consumers[id].dropped.load(std::memory_order_relaxed);
+    }
+    void print_stats() const
+    {
+        for (uint32_t i = 0, sz = num_consumers.load(std::memory_order_acquire); i < sz; i++) {
+            printf("%s: %llu dropped of %llu blocks\n", consumers[i].name, static_cast<unsigned long long>(dropped(i)),
+                   static_cast<unsigned long long>(write_seq.load(std::memory_order_relaxed)));
+        }
+    }
+
+  private:
+    const T *begin_reading(consumer &c, uint64_t seq)
+    {
+        const slot &s = slots[seq & mask];
+        if (s.stamp.load(std::memory_order_acquire) != (2 * seq + 2)) {
+            return nullptr;
+        }
+        c.reading_seq = seq;
+        return &s.value;
+    }
+};
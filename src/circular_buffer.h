@@ -2,77 +2,86 @@
 
 #include <array>
 #include <atomic>
+#include <stdint.h>
 
-#include "spinlock.h"
+#include "constants.h"
 
+// wait-free single producer / single consumer ring
+// indices grow monotonically and are masked on access, each side keeps a cached copy of the other side's index,
+// so the shared cache lines are touched only when the ring looks full or empty
 template <typename T, size_t sz_pow_2>
 class circular_buffer 
 {
-	static constexpr size_t capacity = 1 << sz_pow_2;
+	static constexpr uint32_t capacity = 1 << sz_pow_2;
+	static constexpr uint32_t mask = capacity - 1;
 
-	std::array<T, capacity> queue;
-	uint32_t read_idx;
-	uint32_t write_idx;
-    std::atomic<uint32_t> size{0};
-	spinlock guard;
+	// consumer side
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> read_idx{0};
+	uint32_t cached_write_idx = 0;
+	// producer side
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> write_idx{0};
+	uint32_t cached_read_idx = 0;
+
+	alignas(CACHE_LINE_SIZE) std::array<T, capacity> queue;
 public:
-	circular_buffer() : read_idx(0), write_idx(0) {}
+	circular_buffer() = default;
+
+	// C5220
+	circular_buffer(const circular_buffer&) = delete;
+	circular_buffer& operator=(const circular_buffer&) = delete;
 
+    // can be called from either side
     bool is_empty() const
     {
-        return (size.load() == 0);
+        return (write_idx.load(std::memory_order_acquire) == read_idx.load(std::memory_order_acquire));
     }
 
     bool is_full() const 
     {
-        return (size.load() == capacity);
+        return ((write_idx.load(std::memory_order_acquire) - read_idx.load(std::memory_order_acquire)) == capacity);
     }
 
+    // consumer: peek at the head without releasing the slot
     bool try_read(T& item) 
     {
-        guard.lock();
-        if (is_empty()) {
-            guard.unlock();
-            return false;
+        const uint32_t r_idx = read_idx.load(std::memory_order_relaxed);
+        if (r_idx == cached_write_idx) {
+            cached_write_idx = write_idx.load(std::memory_order_acquire);
+            if (r_idx == cached_write_idx) {
+                return false;
+            }
         }
-        item = queue[read_idx];
-        guard.unlock();
+        item = queue[r_idx & mask];
         return true;
     }
 
+    // consumer: release the head slot after try_read
     void advance() 
     {
-        guard.lock();
-        std::atomic_fetch_add(&size, -1);
-        read_idx = (read_idx + 1) & (capacity - 1);
-        guard.unlock();
+        read_idx.store(read_idx.load(std::memory_order_relaxed) + 1, std::memory_order_release);
     }
 
+    // consumer
     bool try_pop(T &item) 
     {
-        guard.lock();
-        if (is_empty()) {
-            guard.unlock();
+        if (!try_read(item)) {
             return false;
         }
-        item = queue[read_idx];
-        std::atomic_fetch_add(&size, -1);
-        read_idx = (read_idx + 1) & (capacity - 1);
-        guard.unlock();
+        advance();
         return true;
     }
 
+    // producer
     bool try_push(const T task) {
-        guard.lock();
-        if (is_full()) {
-            guard.unlock();
-            return false;
+        const uint32_t w_idx = write_idx.load(std::memory_order_relaxed);
+        if ((w_idx - cached_read_idx) == capacity) {
+            cached_read_idx = read_idx.load(std::memory_order_acquire);
+            if ((w_idx - cached_read_idx) == capacity) {
+                return false;
+            }
         }
-        queue[write_idx] = task;
-        std::atomic_fetch_add(&size, 1);
-        write_idx = (write_idx + 1) & (capacity- 1);
-        guard.unlock();
+        queue[w_idx & mask] = task;
+        write_idx.store(w_idx + 1, std::memory_order_release);
         return true;
     }
 };
-
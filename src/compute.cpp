@@ -219,7 +219,7 @@ cl_int compute_fft::init(visualizer::fft_t& fft)
 void compute_fft::deinit()
 {
 	state_compute.store(0);
-    waveform_consumer->deinit(); // wake up the compute thread
+    waveform_input->wake(consumer_id); // wake up the compute thread
 	if (compute_thread.joinable()) {
 		compute_thread.join();
 	}
@@ -234,17 +234,24 @@ void compute_fft::run()
 
     while (state_compute.load()) {
         const size_t q_id[2] = { (queue_selector + 0) & 0x01, (queue_selector + 1) & 0x01 };
-        waveform_data& wf_data = waveform_consumer->begin_consuming();
+        const waveform_data* wf_data = waveform_input->begin_consuming(consumer_id);
         if (!state_compute.load()) {
             break;
         }
+        if (!wf_data) {
+            continue;
+        }
 
         PROFILE_START("compute_fft::run");
 
-        const cl_int fp_mode = (cl_int)wf_data.fp_mode;
+        const cl_int fp_mode = (cl_int)wf_data->fp_mode;
         const size_t size = VIZ_BUFFER_SIZE * (!fp_mode ? sizeof(int16_t) : sizeof(float));
-        ret = clEnqueueWriteBuffer(context.command_queue[q_id[0]], context.input[q_id[0]], CL_FALSE, 0, size, wf_data.container.data(), 0, NULL, NULL);
+        // blocking write - the slot is read in place and may be reused by the producer afterwards
+        ret = clEnqueueWriteBuffer(context.command_queue[q_id[0]], context.input[q_id[0]], CL_TRUE, 0, size, wf_data->container.data(), 0, NULL, NULL);
         check_result("CL: Failed writing data to device.");
+        if (!waveform_input->end_consuming(consumer_id)) {
+            continue; // overwritten while uploading
+        }
 
         const cl_int output_id = (cl_int)ssbo_buffer_ids->get_back_buffer();
         ssbo_buffer_ids->publish();
@@ -7,7 +7,6 @@
 #include <CL/cl.h>
 
 #include "visualization.h"
-#include "producer_consumer.h"
 
 
 class compute_fft {
@@ -28,7 +27,8 @@ class compute_fft {
     } context;
 
     // waveform input from audio engine
-    producer_consumer<waveform_data>* waveform_consumer = nullptr; // consumer of waveform_producer
+    waveform_channel* waveform_input = nullptr;
+    size_t consumer_id = 0;
 
     // output fft to graphics engine
     triple_indices* ssbo_buffer_ids;  // indices into SSBO array
@@ -52,9 +52,10 @@ private:
     static void compute_mt(void* args);
     void run();
 public:
-    compute_fft(producer_consumer<waveform_data>* wf_consumer) : ssbo_buffer_ids(nullptr), filename(nullptr), queue_selector(0)
+    compute_fft(waveform_channel* wf_channel) : ssbo_buffer_ids(nullptr), filename(nullptr), queue_selector(0)
     { 
-        waveform_consumer = wf_consumer;
+        waveform_input = wf_channel;
+        consumer_id = wf_channel->add_consumer("FFT", true);
         memset(gl_context.ssbo, 0, sizeof(gl_context.ssbo)); 
         gl_context.hGLRC = NULL;
         gl_context.hDC = NULL;
@@ -2,7 +2,6 @@
 
 #define SAMPLE_RATE 48000
 #define NUM_CHANNELS 2
-#define MAX_FILES 32
 #define FRAMES_PER_BUFFER 0x100
 #define VIZ_BUFFER_SIZE (FRAMES_PER_BUFFER * NUM_CHANNELS)
 #define VIZ_BUFFER_SMOOTHING_LEVEL_MIN 1
@@ -11,17 +10,38 @@
 #define MAX_VOLUME 1.0f
 #define FP_IN_VEC 4 // sizeof(__m128) / sizeof(float)
 #define S16_IN_VEC 8 // sizeof(__m128) / sizeof(int16_t)
+#define CACHE_LINE_SIZE 64
 #define NUM_BUFFERS_POW_2 3
-#define NUM_FILES_POW_2 1
+#define WAVEFORM_CHANNEL_POW_2 3
+#define MAX_WAVEFORM_CONSUMERS 4
+#define MAX_VOICES_POW_2 6
+#define MAX_VOICES (1 << MAX_VOICES_POW_2)
+#define BLOCK_FILTER_MAX_VOICES 2 // up to this many voices, the filters run in the latency-bound block mode
+#define NOTE_QUEUE_POW_2 2 // notes planned ahead of the render thread
+#define STREAM_CHUNK_FRAMES 0x4000
+#define SINC_TAPS 16 // polyphase resampler - taps per output sample
+#define SINC_PHASES 32 // fractional positions in the coefficient table
+#define STREAM_HISTORY_FRAMES (SINC_TAPS / 2) // frames before the play position, for the taps reaching back
+#define STREAM_GUARD_FRAMES (2 * FRAMES_PER_BUFFER + SINC_TAPS) // one block at the highest pitch, plus the interpolation taps
+#define MAX_STREAMS (MAX_VOICES + (1 << NOTE_QUEUE_POW_2) + 1) // every voice, every queued note and the one being loaded
 
 #define PI 3.14159265359f
 #define PI_DIV_4 0.78539816339f
 
 #define MAX_DATA_SIZE 0x200000
+#define LIBRARY_MANIFEST_NAME "audio_random_player.manifest"
+#define LIBRARY_WEIGHTS_NAME "audio_random_player.weights"
 #define LFO_BUFFER_SIZE 1024
 
 #define MAX_LPF_FREQ 20000.0f
 #define DEFAULT_LPF_Q 0.707f
+#define MIN_FILTER_FREQ 20.0f
+#define BAND_FILTER_MIN_FREQ 80.0f // band pass, notch and shelves
+#define BAND_FILTER_MAX_FREQ 12000.0f
+#define MAX_SHELF_GAIN_DB 12.0f
+#define MAX_FILTER_SECTIONS 4 // 8 poles
+#define FILTER_CONTROL_FRAMES 16 // the LFO moves the cutoff this often, the coefficients ramp in between
+#define FILTER_LFO_OCTAVES 4.0f // how far down the LFO sweeps the cutoff at the full amount
 
 #define DEFAULT_PITCH_DEVIATION 0
 #define MAX_PITCH_DEVIATION 12
@@ -48,5 +68,12 @@
 #define MIN_LFO_AMOUNT 0
 #define MAX_LFO_AMOUNT 100
 #define INVALID_MAX_FRAMES -1
+#define DEFAULT_RENDER_SECONDS 60
+#define MIN_RENDER_SECONDS 1
+#define MAX_RENDER_SECONDS 3600
+#define DEFAULT_RANDOM_SEED 1
+#define DEFAULT_CACHE_MB 256
+#define MIN_CACHE_MB 16
+#define MAX_CACHE_MB 8192
 
 constexpr size_t TARGET_FPS_mcs = 1000000 / 60;
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+// kernels for newer instruction sets are compiled into every build and picked at runtime
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX2_FMA
+#else
+#include <cpuid.h>
+// without fma in the target, gcc can't contract a separate mul + add - kernels that have to match the scalar path
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif // _MSC_VER
+
+// AVX2 together with FMA - every CPU that has one has the other, and the OS has to save the ymm registers
+inline bool detect_avx2_fma()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return false;
+    __cpuid(regs, 1);
+    const bool fma = (regs[2] & (1 << 12)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    if (!fma || !osxsave || ((_xgetbv(0) & 0x6) != 0x6))
+        return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif // _MSC_VER
+}
+
+inline bool cpu_has_avx2_fma()
+{
+    static const bool supported = detect_avx2_fma();
+    return supported;
+}
@@ -4,8 +4,10 @@
 
 #include "AudioFile.h"
 #include "constants.h"
+#include "cpu_features.h"
 #include "utils.h"
 #include "xmmintrin.h"
+#include "immintrin.h"
 
 namespace dsp
 {
@@ -46,6 +48,65 @@ inline float hadd_sse(const __m128 &accum)
 
 typedef float calc_t;
 
+namespace modulation {
+    class wavetable {
+        float _buffer[LFO_BUFFER_SIZE];
+    public:
+        wavetable()
+        {
+            for (int i = 0; i < LFO_BUFFER_SIZE; i++) {
+                _buffer[i] =
+                    (1.0f - sinf((static_cast<float>(i) / static_cast<float>(LFO_BUFFER_SIZE)) * 2.0f * PI)) * 0.5f;
+            }
+        }
+        const float *buffer() const
+        {
+            return _buffer;
+        }
+    };
+
+    class lfo
+    {
+        const wavetable *_wt;
+        float _read_idx[NUM_CHANNELS];
+        float _inc;
+        float _amount;
+
+    public:
+        lfo(const wavetable* wt = nullptr) : _wt(wt),  _inc(0.0f), _amount(0.0f)
+        {
+            memset(_read_idx, 0, sizeof(_read_idx));
+        }
+        static float increment(float freq)
+        {
+            return static_cast<float>(LFO_BUFFER_SIZE) * freq / static_cast<float>(SAMPLE_RATE);
+        }
+        void set_increment(float inc, float amount)
+        {
+            memset(_read_idx, 0, sizeof(_read_idx));
+            _inc = inc;
+            _amount = amount;
+        }
+        void set_rate(float freq, float amount)
+        {
+            set_increment(increment(freq), amount);
+        }
+        float update(size_t ch)
+        {
+            int r_idx = static_cast<int>(_read_idx[ch]);
+            float frac = _read_idx[ch] - static_cast<float>(r_idx);
+            const int r_idx_next = (r_idx + 1) & (LFO_BUFFER_SIZE - 1);
+            const float res = _wt->buffer()[r_idx] * (1.0f - frac) + _wt->buffer()[r_idx_next] * frac;
+            _read_idx[ch] += _inc;
+            r_idx = static_cast<int>(_read_idx[ch]);
+            frac = _read_idx[ch] - (float)r_idx;
+            r_idx &= (LFO_BUFFER_SIZE - 1);
+            _read_idx[ch] = static_cast<float>(r_idx) + frac;
+            return 1.0f - (res * _amount);
+        }
+    };
+}
+
 namespace biquad
 {
 struct vec
@@ -66,6 +127,76 @@ struct vec
     }
 };
 
+struct coefs
+{
+    vec b12a01; // b1, b2, -a1, -a2 - normalized by a0
+    calc_t b0;
+};
+
+enum class filter_type : uint32_t
+{
+    low_pass,
+    high_pass,
+    band_pass,
+    notch,
+    low_shelf,
+    high_shelf,
+    count
+};
+
+inline coefs normalize(calc_t a0, calc_t a1, calc_t a2, calc_t b0, calc_t b1, calc_t b2)
+{
+    calc_t inv_a0 = 1.f / a0;
+
+    coefs c;
+    c.b12a01.data[2] = -a1 * inv_a0;
+    c.b12a01.data[3] = -a2 * inv_a0;
+    c.b0 = b0 * inv_a0;
+    c.b12a01.data[0] = b1 * inv_a0;
+    c.b12a01.data[1] = b2 * inv_a0;
+    return c;
+}
+
+// RBJ's cookbook, the gain is only used by the shelves
+// the trigonometry can run ahead of time, away from the audio thread
+inline coefs design(filter_type type, calc_t normFreq, calc_t q, calc_t gain_db = calc_t(0.0))
+{
+    calc_t w0 = calc_t(2.0) * PI * normFreq;
+    calc_t cs = cos(w0);
+    calc_t sn = sin(w0);
+    calc_t alph = sn / (calc_t(2.0) * q);
+    calc_t a0 = calc_t(1.0) + alph;
+    calc_t a1 = -calc_t(2.0) * cs;
+    calc_t a2 = calc_t(1.0) - alph;
+
+    switch (type) {
+    case filter_type::low_pass:
+    default: {
+        calc_t ncs = calc_t(1.0) - cs;
+        return normalize(a0, a1, a2, ncs * calc_t(0.5), ncs, ncs * calc_t(0.5));
+    }
+    case filter_type::high_pass: {
+        calc_t pcs = calc_t(1.0) + cs;
+        return normalize(a0, a1, a2, pcs * calc_t(0.5), -pcs, pcs * calc_t(0.5));
+    }
+    case filter_type::band_pass: // 0 dB at the center
+        return normalize(a0, a1, a2, alph, calc_t(0.0), -alph);
+    case filter_type::notch:
+        return normalize(a0, a1, a2, calc_t(1.0), a1, calc_t(1.0));
+    case filter_type::low_shelf:
+    case filter_type::high_shelf: {
+        const calc_t A = powf(calc_t(10.0), gain_db / calc_t(40.0));
+        const calc_t sq = calc_t(2.0) * sqrtf(A) * alph;
+        // the high shelf is the low one with cos(w0) negated and b1, a1 flipped
+        const calc_t c = (type == filter_type::low_shelf) ? cs : -cs;
+        const calc_t sign = (type == filter_type::low_shelf) ? calc_t(1.0) : calc_t(-1.0);
+        return normalize((A + 1) + (A - 1) * c + sq, sign * calc_t(-2.0) * ((A - 1) + (A + 1) * c),
+                         (A + 1) + (A - 1) * c - sq, A * ((A + 1) - (A - 1) * c + sq),
+                         sign * calc_t(2.0) * A * ((A - 1) - (A + 1) * c), A * ((A + 1) - (A - 1) * c - sq));
+    }
+    }
+}
+
 //	Biquad Second Order IIR Low pass Filter
 template <int num_channels> 
 struct low_pass
@@ -76,6 +207,8 @@ struct low_pass
     // padding 12 bytes
 
   public:
+    using coefs = biquad::coefs;
+
     low_pass()
     {
         clear();
@@ -84,22 +217,19 @@ struct low_pass
     {
         memset(h0123, 0, sizeof(h0123));
     }
+
+    static coefs compute(calc_t normFreq, calc_t q)
+    {
+        return design(filter_type::low_pass, normFreq, q);
+    }
+    inline void set(const coefs &c)
+    {
+        b12a01 = c.b12a01;
+        pad = c.b0;
+    }
     inline void setup(calc_t normFreq, calc_t q)
     {
-        calc_t w0 = calc_t(2.0) * PI * normFreq;
-        calc_t cs = cos(w0);
-        calc_t sn = sin(w0);
-        calc_t ncs = calc_t(1.0) - cs;
-
-        calc_t alph = sn / (calc_t(2.0) * q);
-        calc_t b0 = ncs * calc_t(0.5);
-        calc_t b1 = ncs;
-        calc_t b2 = b0;
-        calc_t a0 = calc_t(1.0) + alph;
-        calc_t a1 = -calc_t(2.0) * cs;
-        calc_t a2 = calc_t(1.0) - alph;
-
-        setup(a0, a1, a2, b0, b1, b2);
+        set(compute(normFreq, q));
     }
     inline void process(size_t frames, float *dest, int ch = 0)
     {
@@ -112,16 +242,6 @@ struct low_pass
     }
 
 private:
-    inline void setup(calc_t a0, calc_t a1, calc_t a2, calc_t b0, calc_t b1, calc_t b2)
-    {
-        calc_t inv_a0 = 1.f / a0;
-
-        b12a01.data[2] = -a1 * inv_a0;
-        b12a01.data[3] = -a2 * inv_a0;
-        pad = b0 * inv_a0;
-        b12a01.data[0] = b1 * inv_a0;
-        b12a01.data[1] = b2 * inv_a0;
-    }
     inline calc_t process(calc_t in, int ch = 0)
     {
         assert(ch < num_channels);
@@ -134,76 +254,622 @@ private:
         return out;
     }
 };
-} // namespace biquad
 
-class filter
+// 4 independent biquads, one per lane - channels (or voices) go through a single instruction stream
+// instead of one recursion each. The arithmetic is low_pass's, lane by lane, so the output is identical
+struct low_pass_x4
 {
-    biquad::low_pass<NUM_CHANNELS> _lpf;
+    vec b0, b1, b2, a1, a2; // a1, a2 negated
+    vec x1, x2, y1, y2;
 
-  public:
-    void setup(float f, float r)
+    low_pass_x4()
     {
-        _lpf.clear();
-        _lpf.setup(f / (float)SAMPLE_RATE, r);
+        memset(this, 0, sizeof(*this));
     }
-    void process(buffer_container &buffer, size_t num_channels)
+    void clear()
     {
-        const size_t b_size = buffer[0].size() * FP_IN_VEC;
-        for (size_t ch = 0; ch < num_channels; ch++) {
-            float *dest = (float*)buffer[ch].data();
-            _lpf.process(b_size, dest, (int)ch);
+        x1.m = x2.m = y1.m = y2.m = _mm_setzero_ps();
+    }
+    void set(const coefs &c)
+    {
+        for (size_t lane = 0; lane < 4; lane++)
+            set(lane, c);
+    }
+    void set(size_t lane, const coefs &c)
+    {
+        b0.data[lane] = c.b0;
+        b1.data[lane] = c.b12a01.data[0];
+        b2.data[lane] = c.b12a01.data[1];
+        a1.data[lane] = c.b12a01.data[2];
+        a2.data[lane] = c.b12a01.data[3];
+    }
+    inline __m128 tick(__m128 in)
+    {
+        const __m128 ff = _mm_add_ps(_mm_mul_ps(b1.m, x1.m), _mm_mul_ps(b2.m, x2.m));
+        const __m128 fb = _mm_add_ps(_mm_mul_ps(a1.m, y1.m), _mm_mul_ps(a2.m, y2.m));
+        const __m128 out = _mm_add_ps(_mm_mul_ps(b0.m, in), _mm_add_ps(ff, fb));
+        x2 = x1;
+        x1.m = in;
+        y2 = y1;
+        y1.m = out;
+        return out;
+    }
+    // lane i filters channels[i] in place, frames has to be divisible by 4 - 4 frames are transposed into the lanes at once
+    void process(size_t frames, float *const *channels, size_t num_channels)
+    {
+        assert(num_channels <= 4 && (frames & 0x3) == 0x0);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < frames; i += 4) {
+            __m128 f0 = (num_channels > 0) ? _mm_loadu_ps(channels[0] + i) : zero;
+            __m128 f1 = (num_channels > 1) ? _mm_loadu_ps(channels[1] + i) : zero;
+            __m128 f2 = (num_channels > 2) ? _mm_loadu_ps(channels[2] + i) : zero;
+            __m128 f3 = (num_channels > 3) ? _mm_loadu_ps(channels[3] + i) : zero;
+            _MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+            f0 = tick(f0);
+            f1 = tick(f1);
+            f2 = tick(f2);
+            f3 = tick(f3);
+            _MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+            const __m128 out[4] = {f0, f1, f2, f3};
+            for (size_t ch = 0; ch < num_channels; ch++)
+                _mm_storeu_ps(channels[ch] + i, out[ch]);
         }
     }
 };
 
-namespace modulation {
-    class wavetable {
-        float _buffer[LFO_BUFFER_SIZE];
-    public:
-        wavetable()
-        {
-            for (int i = 0; i < LFO_BUFFER_SIZE; i++) {
-                _buffer[i] =
-                    (1.0f - sinf((static_cast<float>(i) / static_cast<float>(LFO_BUFFER_SIZE)) * 2.0f * PI)) * 0.5f;
+// one channel, 4 outputs per iteration - the recursion is unrolled into a state-space step
+// y[n..n+3] = M * x[n..n+3] + N * (x1, x2, y1, y2), only the y1, y2 terms wait for the previous 4 outputs.
+// It sums in a different order than low_pass, so the two agree within float rounding, not bit for bit
+struct low_pass_block
+{
+    __m128 in_cols[4];    // the 4 outputs' response to x[n + k]
+    __m128 state_cols[4]; // and to x1, x2, y1, y2
+    // what rounding the y1, y2 columns to float left out - the poles of a low cutoff sit close to 1,
+    // so the columns are large and the rounding moves them noticeably
+    __m128 state_cols_lo[2];
+
+    void set(const coefs &c)
+    {
+        const double b[3] = {c.b0, c.b12a01.data[0], c.b12a01.data[1]};
+        const double a[2] = {c.b12a01.data[2], c.b12a01.data[3]};
+        // columns in double, from unit inputs or a unit state
+        auto column = [&b, &a](const double in[4], const double state[4], __m128 *lo) {
+            double x[6] = {state[1], state[0], in[0], in[1], in[2], in[3]}; // x2, x1, x[n]...
+            double y[6] = {state[3], state[2], 0.0, 0.0, 0.0, 0.0};         // y2, y1, y[n]...
+            for (size_t n = 2; n < 6; n++)
+                y[n] = b[0] * x[n] + b[1] * x[n - 1] + b[2] * x[n - 2] + a[0] * y[n - 1] + a[1] * y[n - 2];
+            const __m128 hi = _mm_setr_ps(float(y[2]), float(y[3]), float(y[4]), float(y[5]));
+            if (lo) {
+                alignas(16) float h[4];
+                _mm_store_ps(h, hi);
+                *lo = _mm_setr_ps(float(y[2] - h[0]), float(y[3] - h[1]), float(y[4] - h[2]), float(y[5] - h[3]));
             }
+            return hi;
+        };
+        const double zero[4] = {0.0, 0.0, 0.0, 0.0};
+        for (size_t k = 0; k < 4; k++) {
+            double unit[4] = {0.0, 0.0, 0.0, 0.0};
+            unit[k] = 1.0;
+            in_cols[k] = column(unit, zero, nullptr);
+            state_cols[k] = column(zero, unit, (k >= 2) ? &state_cols_lo[k - 2] : nullptr);
         }
-        const float *buffer() const
-        {
-            return _buffer;
+    }
+    // the state is passed in and out, so that it can be shared with low_pass_x4
+    void process(size_t frames, float *dest, float &x1, float &x2, float &y1, float &y2) const
+    {
+        assert((frames & 0x3) == 0x0);
+        __m128 vx1 = _mm_set1_ps(x1), vx2 = _mm_set1_ps(x2);
+        __m128 vy1 = _mm_set1_ps(y1), vy2 = _mm_set1_ps(y2);
+        for (size_t i = 0; i < frames; i += 4) {
+            const __m128 in = _mm_loadu_ps(dest + i);
+            // everything that doesn't depend on the previous outputs first
+            __m128 acc = _mm_add_ps(_mm_mul_ps(in_cols[0], _mm_shuffle_ps(in, in, _MM_SHUFFLE(0, 0, 0, 0))),
+                                    _mm_mul_ps(in_cols[1], _mm_shuffle_ps(in, in, _MM_SHUFFLE(1, 1, 1, 1))));
+            const __m128 acc2 = _mm_add_ps(_mm_mul_ps(in_cols[2], _mm_shuffle_ps(in, in, _MM_SHUFFLE(2, 2, 2, 2))),
+                                           _mm_mul_ps(in_cols[3], _mm_shuffle_ps(in, in, _MM_SHUFFLE(3, 3, 3, 3))));
+            const __m128 acc_x = _mm_add_ps(_mm_mul_ps(state_cols[0], vx1), _mm_mul_ps(state_cols[1], vx2));
+            acc = _mm_add_ps(_mm_add_ps(acc, acc2), acc_x);
+            const __m128 acc_y_lo = _mm_add_ps(_mm_mul_ps(state_cols_lo[0], vy1), _mm_mul_ps(state_cols_lo[1], vy2));
+            const __m128 acc_y = _mm_add_ps(_mm_mul_ps(state_cols[2], vy1), _mm_mul_ps(state_cols[3], vy2));
+            const __m128 out = _mm_add_ps(_mm_add_ps(acc, acc_y_lo), acc_y);
+            _mm_storeu_ps(dest + i, out);
+            vx1 = _mm_shuffle_ps(in, in, _MM_SHUFFLE(3, 3, 3, 3));
+            vx2 = _mm_shuffle_ps(in, in, _MM_SHUFFLE(2, 2, 2, 2));
+            vy1 = _mm_shuffle_ps(out, out, _MM_SHUFFLE(3, 3, 3, 3));
+            vy2 = _mm_shuffle_ps(out, out, _MM_SHUFFLE(2, 2, 2, 2));
         }
+        x1 = _mm_cvtss_f32(vx1);
+        x2 = _mm_cvtss_f32(vx2);
+        y1 = _mm_cvtss_f32(vy1);
+        y2 = _mm_cvtss_f32(vy2);
+    }
+};
+
+// up to 4 sections in series, one per lane - section k filters what section k - 1 produced a sample earlier,
+// so the whole chain advances with one vector step per sample, like a single section does.
+// The output comes num_sections - 1 samples late
+template <int num_channels>
+struct cascade
+{
+    static constexpr uint32_t max_sections = FP_IN_VEC;
+
+    struct coefs
+    {
+        biquad::coefs section[max_sections];
+        uint32_t num_sections;
     };
 
-    class lfo
+    vec b0, b1, b2, a1, a2; // lane per section, a1, a2 negated
+    __m128 x1[num_channels], x2[num_channels], y1[num_channels], y2[num_channels];
+    uint32_t out_lane;
+
+    cascade()
     {
-        const wavetable *_wt;
-        float _read_idx[NUM_CHANNELS];
-        float _inc;
-        float _amount;
+        memset(this, 0, sizeof(*this));
+    }
+    void clear()
+    {
+        for (int ch = 0; ch < num_channels; ch++)
+            x1[ch] = x2[ch] = y1[ch] = y2[ch] = _mm_setzero_ps();
+    }
+    void set(const coefs &c)
+    {
+        assert(c.num_sections >= 1 && c.num_sections <= max_sections);
+        for (uint32_t lane = 0; lane < max_sections; lane++) {
+            // lanes past the last section just pass the signal on
+            const bool used = (lane < c.num_sections);
+            b0.data[lane] = used ? c.section[lane].b0 : 1.0f;
+            b1.data[lane] = used ? c.section[lane].b12a01.data[0] : 0.0f;
+            b2.data[lane] = used ? c.section[lane].b12a01.data[1] : 0.0f;
+            a1.data[lane] = used ? c.section[lane].b12a01.data[2] : 0.0f;
+            a2.data[lane] = used ? c.section[lane].b12a01.data[3] : 0.0f;
+        }
+        out_lane = c.num_sections - 1;
+    }
+    // frames has to be divisible by 4, the channels are interleaved in the loop - their recursions are independent
+    void process(size_t frames, float *const *channels, size_t num_active)
+    {
+        assert((frames & 0x3) == 0x0 && num_active <= num_channels);
+        for (size_t i = 0; i < frames; i += 4) {
+            for (size_t ch = 0; ch < num_active; ch++) {
+                const __m128 in = _mm_loadu_ps(channels[ch] + i);
+                __m128 out[4];
+                out[0] = tick(ch, in);
+                out[1] = tick(ch, _mm_shuffle_ps(in, in, _MM_SHUFFLE(1, 1, 1, 1)));
+                out[2] = tick(ch, _mm_shuffle_ps(in, in, _MM_SHUFFLE(2, 2, 2, 2)));
+                out[3] = tick(ch, _mm_shuffle_ps(in, in, _MM_SHUFFLE(3, 3, 3, 3)));
+                // 4 samples of every section, the last one's are the output
+                _MM_TRANSPOSE4_PS(out[0], out[1], out[2], out[3]);
+                _mm_storeu_ps(channels[ch] + i, out[out_lane]);
+            }
+        }
+    }
 
-    public:
-        lfo(const wavetable* wt) : _wt(wt),  _inc(0.0f), _amount(0.0f)
-        {
-            memset(_read_idx, 0, sizeof(_read_idx));
+  private:
+    // the input sample in the lowest lane, the other lanes take the previous output of the section before them
+    inline __m128 tick(size_t ch, __m128 in)
+    {
+        const __m128 prev = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y1[ch]), 4));
+        const __m128 x = _mm_move_ss(prev, in);
+        const __m128 ff = _mm_add_ps(_mm_mul_ps(b1.m, x1[ch]), _mm_mul_ps(b2.m, x2[ch]));
+        const __m128 fb = _mm_add_ps(_mm_mul_ps(a1.m, y1[ch]), _mm_mul_ps(a2.m, y2[ch]));
+        const __m128 out = _mm_add_ps(_mm_mul_ps(b0.m, x), _mm_add_ps(ff, fb));
+        x2[ch] = x1[ch];
+        x1[ch] = x;
+        y2[ch] = y1[ch];
+        y1[ch] = out;
+        return out;
+    }
+};
+
+// 8 lanes - needs AVX, check cpu_has_avx2_fma() first
+struct low_pass_x8
+{
+    alignas(32) float b0[8], b1[8], b2[8], a1[8], a2[8]; // a1, a2 negated
+    alignas(32) float state[4][8]; // x1, x2, y1, y2
+
+    low_pass_x8()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+    void clear()
+    {
+        memset(state, 0, sizeof(state));
+    }
+    void set(size_t lane, const coefs &c)
+    {
+        b0[lane] = c.b0;
+        b1[lane] = c.b12a01.data[0];
+        b2[lane] = c.b12a01.data[1];
+        a1[lane] = c.b12a01.data[2];
+        a2[lane] = c.b12a01.data[3];
+    }
+    // like low_pass_x4::process, up to 8 channels
+    TARGET_AVX2 void process(size_t frames, float *const *channels, size_t num_channels)
+    {
+        assert(num_channels <= 8 && (frames & 0x3) == 0x0);
+        const __m256 vb0 = _mm256_load_ps(b0), vb1 = _mm256_load_ps(b1), vb2 = _mm256_load_ps(b2);
+        const __m256 va1 = _mm256_load_ps(a1), va2 = _mm256_load_ps(a2);
+        __m256 x1 = _mm256_load_ps(state[0]), x2 = _mm256_load_ps(state[1]);
+        __m256 y1 = _mm256_load_ps(state[2]), y2 = _mm256_load_ps(state[3]);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < frames; i += 4) {
+            __m128 lo[4], hi[4];
+            for (size_t ch = 0; ch < 4; ch++) {
+                lo[ch] = (ch < num_channels) ? _mm_loadu_ps(channels[ch] + i) : zero;
+                hi[ch] = ((ch + 4) < num_channels) ? _mm_loadu_ps(channels[ch + 4] + i) : zero;
+            }
+            _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+            _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+            for (size_t f = 0; f < 4; f++) {
+                const __m256 in = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[f]), hi[f], 1);
+                const __m256 ff = _mm256_add_ps(_mm256_mul_ps(vb1, x1), _mm256_mul_ps(vb2, x2));
+                const __m256 fb = _mm256_add_ps(_mm256_mul_ps(va1, y1), _mm256_mul_ps(va2, y2));
+                const __m256 out = _mm256_add_ps(_mm256_mul_ps(vb0, in), _mm256_add_ps(ff, fb));
+                x2 = x1;
+                x1 = in;
+                y2 = y1;
+                y1 = out;
+                lo[f] = _mm256_castps256_ps128(out);
+                hi[f] = _mm256_extractf128_ps(out, 1);
+            }
+            _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+            _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+            for (size_t ch = 0; ch < num_channels; ch++)
+                _mm_storeu_ps(channels[ch] + i, (ch < 4) ? lo[ch] : hi[ch - 4]);
         }
-        void set_rate(float freq, float amount)
-        {
-            memset(_read_idx, 0, sizeof(_read_idx));
-            _inc = static_cast<float>(LFO_BUFFER_SIZE) * freq / static_cast<float>(SAMPLE_RATE);
-            _amount = amount;
+        _mm256_store_ps(state[0], x1);
+        _mm256_store_ps(state[1], x2);
+        _mm256_store_ps(state[2], y1);
+        _mm256_store_ps(state[3], y2);
+    }
+};
+} // namespace biquad
+
+// topology-preserving state variable filter - trapezoidal integrators, after Zavalishin and Simper. The state is
+// the integrators' charge instead of past outputs, so the cutoff can move while the filter runs.
+// With the exact tan its response is the same as the RBJ biquad's
+namespace svf
+{
+// tan(x) on [0, pi/2), the [5/4] Pade approximant - within 1e-5 relative up to 0.42 of the sample rate
+inline float fast_tan(float x)
+{
+    const float x2 = x * x;
+    return x * (945.0f + x2 * (-105.0f + x2)) / (945.0f + x2 * (-420.0f + 15.0f * x2));
+}
+
+// 2^x for x > -126, a cubic on the fraction, the integer part goes straight into the exponent - within 2e-4 relative
+inline float fast_exp2(float x)
+{
+    const float whole = floorf(x);
+    const float f = x - whole;
+    const float p = 1.0f + f * (0.6960656f + f * (0.2244943f + f * 0.0794402f));
+    const uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(whole) + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// everything in a section but the cutoff
+struct section
+{
+    float k; // 1 / q
+    float g_scale; // the shelves move the cutoff by sqrt(A)
+    float m0, m1, m2; // the output is m0 * input + m1 * band pass + m2 * low pass
+};
+
+// the gain is only used by the shelves, they follow RBJ's definition of A
+inline section design(biquad::filter_type type, float q, float gain_db = 0.0f)
+{
+    using biquad::filter_type;
+    const float k = 1.0f / q;
+    switch (type) {
+    case filter_type::low_pass:
+    default:
+        return {k, 1.0f, 0.0f, 0.0f, 1.0f};
+    case filter_type::high_pass:
+        return {k, 1.0f, 1.0f, -k, -1.0f};
+    case filter_type::band_pass: // 0 dB at the center
+        return {k, 1.0f, 0.0f, k, 0.0f};
+    case filter_type::notch:
+        return {k, 1.0f, 1.0f, -k, 0.0f};
+    case filter_type::low_shelf: {
+        const float A = powf(10.0f, gain_db / 40.0f);
+        return {k, 1.0f / sqrtf(A), 1.0f, k * (A - 1.0f), A * A - 1.0f};
+    }
+    case filter_type::high_shelf: {
+        const float A = powf(10.0f, gain_db / 40.0f);
+        return {k, sqrtf(A), A * A, k * (1.0f - A) * A, 1.0f - A * A};
+    }
+    }
+}
+
+// up to 4 sections in series, one per lane, pipelined like biquad::cascade - the output comes num_sections - 1
+// samples late. The LFO sets the cutoff every FILTER_CONTROL_FRAMES, the coefficients ramp to it sample by sample
+template <int num_channels>
+struct cascade
+{
+    static constexpr uint32_t max_sections = FP_IN_VEC;
+
+    struct coefs
+    {
+        biquad::vec k, g_scale, m0, m1, m2; // lane per section
+        float norm_freq; // the cutoff with the LFO at its top
+        uint32_t num_sections;
+    };
+
+    // one step of a section as a state-space update, in the integrators' charge ic1, ic2 and the input v0:
+    // ic1' = p11 * ic1 + q1 * (v0 - ic2), ic2' = q1 * ic1 + p22 * ic2 + q2 * v0, out = r1 * ic1 + r2 * ic2 + direct * v0.
+    // All of them are linear in a1, a2, a3, so ramping them is ramping the a's
+    struct step_coefs
+    {
+        __m128 p11, p22, q1, q2;
+        __m128 r1, r2, direct;
+    };
+
+    biquad::vec k, g_scale, m0, m1, m2;
+    step_coefs ramp; // where the ramp is, the same in every lane
+    __m128 ic1[num_channels], ic2[num_channels], y[num_channels];
+    float norm_freq;
+    uint32_t out_lane;
+    bool ramping; // the first control block starts at its cutoff instead of ramping from the unmodulated one
+
+    cascade()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+    void clear()
+    {
+        for (int ch = 0; ch < num_channels; ch++)
+            ic1[ch] = ic2[ch] = y[ch] = _mm_setzero_ps();
+        ramping = false;
+    }
+    void set(const coefs &c)
+    {
+        assert(c.num_sections >= 1 && c.num_sections <= max_sections);
+        for (uint32_t lane = 0; lane < max_sections; lane++) {
+            // lanes past the last section just pass the signal on
+            const bool used = (lane < c.num_sections);
+            k.data[lane] = used ? c.k.data[lane] : 2.0f;
+            g_scale.data[lane] = used ? c.g_scale.data[lane] : 1.0f;
+            m0.data[lane] = used ? c.m0.data[lane] : 1.0f;
+            m1.data[lane] = used ? c.m1.data[lane] : 0.0f;
+            m2.data[lane] = used ? c.m2.data[lane] : 0.0f;
         }
-        float update(size_t ch)
-        {
-            int r_idx = static_cast<int>(_read_idx[ch]);
-            float frac = _read_idx[ch] - static_cast<float>(r_idx);
-            const int r_idx_next = (r_idx + 1) & (LFO_BUFFER_SIZE - 1);
-            const float res = _wt->buffer()[r_idx] * (1.0f - frac) + _wt->buffer()[r_idx_next] * frac;
-            _read_idx[ch] += _inc;
-            r_idx = static_cast<int>(_read_idx[ch]);
-            frac = _read_idx[ch] - (float)r_idx;
-            r_idx &= (LFO_BUFFER_SIZE - 1);
-            _read_idx[ch] = static_cast<float>(r_idx) + frac;
-            return 1.0f - (res * _amount);
+        norm_freq = c.norm_freq;
+        out_lane = c.num_sections - 1;
+    }
+    // frames has to be divisible by FILTER_CONTROL_FRAMES, the LFO is read once per control block
+    void process(size_t frames, float *const *channels, size_t num_active, modulation::lfo &lfo)
+    {
+        static_assert((FILTER_CONTROL_FRAMES & 0x3) == 0x0, "4 frames are transposed at once.");
+        assert((frames % FILTER_CONTROL_FRAMES) == 0 && num_active <= num_channels);
+        const __m128 ramp_scale = _mm_set1_ps(1.0f / static_cast<float>(FILTER_CONTROL_FRAMES));
+        // the members are copied out, the stores to the buffer could alias them
+        step_coefs c = ramp;
+        channel_state st[num_channels];
+        for (size_t ch = 0; ch < num_active; ch++)
+            st[ch] = {ic1[ch], ic2[ch], y[ch]};
+        step_coefs target = targets(lfo.update(0));
+        for (size_t block = 0; block < frames; block += FILTER_CONTROL_FRAMES) {
+            if (!ramping) {
+                c = target;
+                ramping = true;
+            }
+            step_coefs delta;
+            delta.p11 = _mm_mul_ps(_mm_sub_ps(target.p11, c.p11), ramp_scale);
+            delta.p22 = _mm_mul_ps(_mm_sub_ps(target.p22, c.p22), ramp_scale);
+            delta.q1 = _mm_mul_ps(_mm_sub_ps(target.q1, c.q1), ramp_scale);
+            delta.q2 = _mm_mul_ps(_mm_sub_ps(target.q2, c.q2), ramp_scale);
+            delta.r1 = _mm_mul_ps(_mm_sub_ps(target.r1, c.r1), ramp_scale);
+            delta.r2 = _mm_mul_ps(_mm_sub_ps(target.r2, c.r2), ramp_scale);
+            delta.direct = _mm_mul_ps(_mm_sub_ps(target.direct, c.direct), ramp_scale);
+            // the next target is a long dependency chain, it runs alongside this block's samples
+            if (block + FILTER_CONTROL_FRAMES < frames)
+                target = targets(lfo.update(0));
+            for (size_t i = block; i < block + FILTER_CONTROL_FRAMES; i += 4) {
+                // the coefficients of 4 frames, the channels share them
+                step_coefs frame_c[4];
+                for (size_t j = 0; j < 4; j++) {
+                    c.p11 = _mm_add_ps(c.p11, delta.p11);
+                    c.p22 = _mm_add_ps(c.p22, delta.p22);
+                    c.q1 = _mm_add_ps(c.q1, delta.q1);
+                    c.q2 = _mm_add_ps(c.q2, delta.q2);
+                    c.r1 = _mm_add_ps(c.r1, delta.r1);
+                    c.r2 = _mm_add_ps(c.r2, delta.r2);
+                    c.direct = _mm_add_ps(c.direct, delta.direct);
+                    frame_c[j] = c;
+                }
+                for (size_t ch = 0; ch < num_active; ch++) {
+                    const __m128 in = _mm_loadu_ps(channels[ch] + i);
+                    __m128 out[4];
+                    out[0] = tick(st[ch], in, frame_c[0]);
+                    out[1] = tick(st[ch], _mm_shuffle_ps(in, in, _MM_SHUFFLE(1, 1, 1, 1)), frame_c[1]);
+                    out[2] = tick(st[ch], _mm_shuffle_ps(in, in, _MM_SHUFFLE(2, 2, 2, 2)), frame_c[2]);
+                    out[3] = tick(st[ch], _mm_shuffle_ps(in, in, _MM_SHUFFLE(3, 3, 3, 3)), frame_c[3]);
+                    _MM_TRANSPOSE4_PS(out[0], out[1], out[2], out[3]);
+                    _mm_storeu_ps(channels[ch] + i, out[out_lane]);
+                }
+            }
+        }
+        ramp = c;
+        for (size_t ch = 0; ch < num_active; ch++) {
+            ic1[ch] = st[ch].ic1;
+            ic2[ch] = st[ch].ic2;
+            y[ch] = st[ch].y;
         }
+    }
+
+  private:
+    struct channel_state
+    {
+        __m128 ic1, ic2, y;
     };
-}
+
+    // the LFO moves the cutoff down by up to FILTER_LFO_OCTAVES - no trigonometry and one division
+    // per control block, for all the sections.
+    // a1 = 1 / (1 + g * (g + k)), a2 = g * a1, a3 = g * a2, v1 = a1 * ic1 + a2 * (v0 - ic2),
+    // v2 = ic2 + a2 * ic1 + a3 * (v0 - ic2), ic1' = 2 * v1 - ic1, ic2' = 2 * v2 - ic2, out = m0 * v0 + m1 * v1 + m2 * v2
+    // multiplied out - the recursion is a multiply and two adds deep instead of five operations
+    inline step_coefs targets(float lfo_value) const
+    {
+        const float f = norm_freq * fast_exp2(-FILTER_LFO_OCTAVES * (1.0f - lfo_value));
+        const __m128 g = _mm_mul_ps(_mm_set1_ps(fast_tan(PI * f)), g_scale.m);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 a1 = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(g, _mm_add_ps(g, k.m))));
+        const __m128 a2 = _mm_mul_ps(g, a1);
+        const __m128 a3 = _mm_mul_ps(g, a2);
+        step_coefs c;
+        c.p11 = _mm_sub_ps(_mm_add_ps(a1, a1), one);
+        c.p22 = _mm_sub_ps(one, _mm_add_ps(a3, a3));
+        c.q1 = _mm_add_ps(a2, a2);
+        c.q2 = _mm_add_ps(a3, a3);
+        c.r1 = _mm_add_ps(_mm_mul_ps(m1.m, a1), _mm_mul_ps(m2.m, a2));
+        c.r2 = _mm_sub_ps(_mm_mul_ps(m2.m, _mm_sub_ps(one, a3)), _mm_mul_ps(m1.m, a2));
+        c.direct = _mm_add_ps(m0.m, _mm_add_ps(_mm_mul_ps(m1.m, a2), _mm_mul_ps(m2.m, a3)));
+        return c;
+    }
+    // the input sample in the lowest lane, the other lanes take the previous output of the section before them
+    static inline __m128 tick(channel_state &st, __m128 in, const step_coefs &c)
+    {
+        const __m128 prev = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(st.y), 4));
+        const __m128 v0 = _mm_move_ss(prev, in);
+        const __m128 out =
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(c.r1, st.ic1), _mm_mul_ps(c.r2, st.ic2)), _mm_mul_ps(c.direct, v0));
+        const __m128 ic1 = _mm_add_ps(_mm_mul_ps(c.p11, st.ic1), _mm_mul_ps(c.q1, _mm_sub_ps(v0, st.ic2)));
+        const __m128 ic2 =
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(c.q1, st.ic1), _mm_mul_ps(c.p22, st.ic2)), _mm_mul_ps(c.q2, v0));
+        st.ic1 = ic1;
+        st.ic2 = ic2;
+        st.y = out;
+        return out;
+    }
+};
+} // namespace svf
+
+class filter
+{
+    static_assert(NUM_CHANNELS <= 4, "A channel per lane.");
+    biquad::low_pass_x4 _lpf; // both channels in one vector
+    biquad::low_pass_block _lpf_block; // same coefficients, works on _lpf's state
+    biquad::cascade<NUM_CHANNELS> _cascade; // more than one section
+    svf::cascade<NUM_CHANNELS> _svf; // the cutoff follows the LFO
+    uint32_t _num_sections;
+    bool _modulated;
+
+  public:
+    // the low and high pass sections are butterworth's, scaled by r / DEFAULT_LPF_Q, the others all use r
+    static float section_q(biquad::filter_type type, uint32_t num_sections, uint32_t section, float r)
+    {
+        const bool butterworth = (type == biquad::filter_type::low_pass || type == biquad::filter_type::high_pass);
+        if (!butterworth || num_sections == 1)
+            return r;
+        const float theta = PI * static_cast<float>(2 * section + 1) / static_cast<float>(4 * num_sections);
+        return (r / DEFAULT_LPF_Q) / (2.0f * cosf(theta));
+    }
+
+    using coefs = biquad::cascade<NUM_CHANNELS>::coefs;
+    using modulated_coefs = svf::cascade<NUM_CHANNELS>::coefs;
+
+    filter() : _num_sections(1), _modulated(false)
+    {
+    }
+    // the 2-pole low pass
+    static coefs compute(float f, float r)
+    {
+        return compute(biquad::filter_type::low_pass, 1, f, r, 0.0f);
+    }
+    // 2 poles per section, the sections split the gain
+    static coefs compute(biquad::filter_type type, uint32_t num_sections, float f, float r, float gain_db)
+    {
+        assert(num_sections >= 1 && num_sections <= biquad::cascade<NUM_CHANNELS>::max_sections);
+        coefs c;
+        c.num_sections = num_sections;
+        const float norm_freq = f / (float)SAMPLE_RATE;
+        for (uint32_t k = 0; k < num_sections; k++) {
+            c.section[k] = biquad::design(type, norm_freq, section_q(type, num_sections, k, r),
+                                          gain_db / static_cast<float>(num_sections));
+        }
+        return c;
+    }
+    // the same filter for the LFO to sweep, f is the top of the sweep
+    static modulated_coefs compute_modulated(biquad::filter_type type, uint32_t num_sections, float f, float r,
+                                             float gain_db)
+    {
+        assert(num_sections >= 1 && num_sections <= svf::cascade<NUM_CHANNELS>::max_sections);
+        modulated_coefs c;
+        c.num_sections = num_sections;
+        c.norm_freq = f / (float)SAMPLE_RATE;
+        for (uint32_t k = 0; k < num_sections; k++) {
+            const svf::section s =
+                svf::design(type, section_q(type, num_sections, k, r), gain_db / static_cast<float>(num_sections));
+            c.k.data[k] = s.k;
+            c.g_scale.data[k] = s.g_scale;
+            c.m0.data[k] = s.m0;
+            c.m1.data[k] = s.m1;
+            c.m2.data[k] = s.m2;
+        }
+        return c;
+    }
+    void set(const coefs &c)
+    {
+        _modulated = false;
+        _num_sections = c.num_sections;
+        if (_num_sections == 1) {
+            _lpf.clear();
+            _lpf.set(c.section[0]);
+            _lpf_block.set(c.section[0]);
+        } else {
+            _cascade.clear();
+            _cascade.set(c);
+        }
+    }
+    // lfo has to advance FILTER_CONTROL_FRAMES per update
+    void set(const modulated_coefs &c)
+    {
+        _modulated = true;
+        _num_sections = c.num_sections;
+        _svf.clear();
+        _svf.set(c);
+    }
+    void setup(float f, float r)
+    {
+        set(compute(f, r));
+    }
+    // the cascades' output comes num_sections - 1 samples late, the single section's doesn't
+    uint32_t latency() const
+    {
+        return _num_sections - 1;
+    }
+    // block - a channel at a time through the state-space kernel, it has the shorter dependency chain,
+    // the lanes do less work per sample. The modes can change from one buffer to the next.
+    // A cascade always runs its sections in the lanes, which delays the output by latency() samples - the voice
+    // renders one more block to flush the end of the note, the onset stays up to 3 samples (62 us) late against
+    // a 2-pole voice. lfo is only read by a modulated filter
+    void process(buffer_container &buffer, size_t num_channels, bool block, modulation::lfo &lfo)
+    {
+        float *channels[NUM_CHANNELS];
+        for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+            channels[ch] = (float *)buffer[ch].data();
+        }
+        const size_t num_frames = buffer[0].size() * FP_IN_VEC;
+        if (_modulated) {
+            _svf.process(num_frames, channels, num_channels, lfo);
+            return;
+        }
+        if (_num_sections > 1) {
+            _cascade.process(num_frames, channels, num_channels);
+            return;
+        }
+        if (!block) {
+            _lpf.process(num_frames, channels, num_channels);
+            return;
+        }
+        for (size_t ch = 0; ch < num_channels; ch++) {
+            _lpf_block.process(num_frames, channels[ch], _lpf.x1.data[ch], _lpf.x2.data[ch], _lpf.y1.data[ch],
+                               _lpf.y2.data[ch]);
+        }
+    }
+};
+
 } // namespace dsp
\ No newline at end of file
@@ -2,48 +2,71 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "cpu_features.h"
 
 namespace librandom
 {
-// randu algorithm
-class randu
+// expands a single seed into generator states
+inline uint64_t splitmix64(uint64_t &x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256++ - not shared between threads, every thread owns a generator seeded with its own stream id
+class xoshiro256pp
 {
   private:
-    volatile int64_t _rnd;
+    uint64_t _s[4];
 
   public:
-    inline randu(const int64_t _seed = 1) : _rnd(_seed)
+    inline xoshiro256pp(const uint64_t seed = 1, const uint64_t stream = 0)
     {
+        this->seed(seed, stream);
     }
 
     // C5220
-    randu(const randu&) = delete;
-    randu&operator=(const randu&) = delete;
-    randu(randu&&) = delete;
-    randu &operator=(randu&&) = delete;
+    xoshiro256pp(const xoshiro256pp&) = delete;
+    xoshiro256pp&operator=(const xoshiro256pp&) = delete;
+    xoshiro256pp(xoshiro256pp&&) = delete;
+    xoshiro256pp &operator=(xoshiro256pp&&) = delete;
 
-    inline void seed(const int64_t val)
+    // streams of the same seed don't overlap for 2^128 draws each
+    inline void seed(uint64_t seed, uint64_t stream = 0)
     {
-        _rnd = val;
+        for (uint64_t &s : _s)
+            s = splitmix64(seed);
+        for (uint64_t i = 0; i < stream; i++)
+            jump();
     }
-    inline int64_t seed() const
-    {
-        return _rnd;
-    }
-    inline int32_t max_i() const
+
+    inline uint64_t u64()
     {
-        return 32767;
+        const uint64_t result = rotl(_s[0] + _s[3], 23) + _s[0];
+        const uint64_t t = _s[1] << 17;
+        _s[2] ^= _s[0];
+        _s[3] ^= _s[1];
+        _s[1] ^= _s[2];
+        _s[0] ^= _s[3];
+        _s[2] ^= t;
+        _s[3] = rotl(_s[3], 45);
+        return result;
     }
-
-    inline int32_t i()
+    inline uint32_t u32()
     {
-        return (((_rnd = _rnd * 214013L + 2531011L) >> 16) & 0x7fff);
+        return static_cast<uint32_t>(u64() >> 32);
     }
 
+    // [0, max) - multiply-shift instead of a division
     inline int32_t i(int32_t max)
     {
-        assert(max);
-        return i() % max;
+        assert(max > 0);
+        return static_cast<int32_t>((uint64_t(u32()) * uint64_t(max)) >> 32);
     }
     inline int32_t i(int32_t min, int32_t max)
     {
@@ -58,13 +81,10 @@ class randu
         return offs + is(range);
     }
 
-    inline float max_fp()
-    {
-        return 32767.f;
-    }
+    // [0, 1) with 24 bits of resolution
     inline float fp()
     {
-        return float(i()) / max_fp();
+        return static_cast<float>(u64() >> 40) * (1.0f / 16777216.0f);
     }
     inline float fp(float max)
     {
@@ -82,5 +102,155 @@ class randu
     {
         return offs + fp_s(range);
     }
+
+  private:
+    static inline uint64_t rotl(const uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+    // equivalent to 2^128 draws
+    inline void jump()
+    {
+        static const uint64_t jump_poly[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+        uint64_t s[4] = {0, 0, 0, 0};
+        for (uint64_t poly : jump_poly) {
+            for (int b = 0; b < 64; b++) {
+                if (poly & (uint64_t(1) << b)) {
+                    s[0] ^= _s[0];
+                    s[1] ^= _s[1];
+                    s[2] ^= _s[2];
+                    s[3] ^= _s[3];
+                }
+                u64();
+            }
+        }
+        memcpy(_s, s, sizeof(_s));
+    }
+};
+
+// 8 interleaved xoshiro128+ lanes for filling whole buffers with floats - one AVX2 or two SSE registers per step,
+// picked at runtime. The lanes are the same either way, so the output doesn't depend on the instruction set
+class xoshiro128p_x8
+{
+  private:
+    static constexpr size_t num_lanes = 8;
+
+    alignas(32) uint32_t _s[4][num_lanes];
+
+  public:
+    inline xoshiro128p_x8(const uint64_t seed = 1, const uint64_t stream = 0)
+    {
+        this->seed(seed, stream);
+    }
+
+    // C5220
+    xoshiro128p_x8(const xoshiro128p_x8&) = delete;
+    xoshiro128p_x8&operator=(const xoshiro128p_x8&) = delete;
+    xoshiro128p_x8(xoshiro128p_x8&&) = delete;
+    xoshiro128p_x8 &operator=(xoshiro128p_x8&&) = delete;
+
+    inline void seed(uint64_t seed, uint64_t stream = 0)
+    {
+        xoshiro256pp gen(seed, stream);
+        for (size_t lane = 0; lane < num_lanes; lane++) {
+            do {
+                for (size_t w = 0; w < 4; w++)
+                    _s[w][lane] = gen.u32();
+            } while (!(_s[0][lane] | _s[1][lane] | _s[2][lane] | _s[3][lane])); // all-zero state is a fixed point
+        }
+    }
+
+    // uniform floats in [min, max)
+    void fill(float *dst, size_t count, float min, float max)
+    {
+        if (cpu_has_avx2_fma())
+            fill_avx2(dst, count, min, max);
+        else
+            fill_sse2(dst, count, min, max);
+    }
+    // both kernels are public for the benchmark - the lanes step in both halves of a register the same way
+    void fill_sse2(float *dst, size_t count, float min, float max)
+    {
+        const size_t num_steps = count / num_lanes;
+        const __m128 scale = _mm_set1_ps(max - min);
+        const __m128 offset = _mm_set1_ps(min - (max - min)); // the mantissa trick yields [1, 2)
+        for (size_t half = 0; half < 2; half++) {
+            __m128i s0 = _mm_load_si128(reinterpret_cast<const __m128i *>(_s[0] + half * 4));
+            __m128i s1 = _mm_load_si128(reinterpret_cast<const __m128i *>(_s[1] + half * 4));
+            __m128i s2 = _mm_load_si128(reinterpret_cast<const __m128i *>(_s[2] + half * 4));
+            __m128i s3 = _mm_load_si128(reinterpret_cast<const __m128i *>(_s[3] + half * 4));
+            for (size_t i = 0; i < num_steps; i++) {
+                const __m128i result = _mm_add_epi32(s0, s3);
+                next(s0, s1, s2, s3);
+                _mm_storeu_ps(dst + i * num_lanes + half * 4, _mm_add_ps(_mm_mul_ps(to_unit_interval(result), scale), offset));
+            }
+            _mm_store_si128(reinterpret_cast<__m128i *>(_s[0] + half * 4), s0);
+            _mm_store_si128(reinterpret_cast<__m128i *>(_s[1] + half * 4), s1);
+            _mm_store_si128(reinterpret_cast<__m128i *>(_s[2] + half * 4), s2);
+            _mm_store_si128(reinterpret_cast<__m128i *>(_s[3] + half * 4), s3);
+        }
+        fill_tail(dst, count, num_steps, min, max);
+    }
+    // without fma in the target the mul + add isn't contracted, so the floats are the SSE2 kernel's
+    TARGET_AVX2 void fill_avx2(float *dst, size_t count, float min, float max)
+    {
+        const size_t num_steps = count / num_lanes;
+        __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(_s[0]));
+        __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(_s[1]));
+        __m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i *>(_s[2]));
+        __m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i *>(_s[3]));
+        const __m256 scale = _mm256_set1_ps(max - min);
+        const __m256 offset = _mm256_set1_ps(min - (max - min)); // the mantissa trick yields [1, 2)
+        for (size_t i = 0; i < num_steps; i++) {
+            const __m256i result = _mm256_add_epi32(s0, s3);
+            next(s0, s1, s2, s3);
+            _mm256_storeu_ps(dst + i * num_lanes, _mm256_add_ps(_mm256_mul_ps(to_unit_interval(result), scale), offset));
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i *>(_s[0]), s0);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(_s[1]), s1);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(_s[2]), s2);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(_s[3]), s3);
+        fill_tail(dst, count, num_steps, min, max);
+    }
+
+  private:
+    // the tail takes one more step, its unused lanes are dropped
+    void fill_tail(float *dst, size_t count, size_t num_steps, float min, float max)
+    {
+        const size_t tail = count - num_steps * num_lanes;
+        if (tail) {
+            alignas(32) float rest[num_lanes];
+            fill_sse2(rest, num_lanes, min, max);
+            memcpy(dst + num_steps * num_lanes, rest, tail * sizeof(float));
+        }
+    }
+    static TARGET_AVX2 inline __m256 to_unit_interval(__m256i x)
+    {
+        return _mm256_castsi256_ps(_mm256_or_si256(_mm256_srli_epi32(x, 9), _mm256_set1_epi32(0x3f800000)));
+    }
+    static TARGET_AVX2 inline void next(__m256i &s0, __m256i &s1, __m256i &s2, __m256i &s3)
+    {
+        const __m256i t = _mm256_slli_epi32(s1, 9);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+    }
+    static inline __m128 to_unit_interval(__m128i x)
+    {
+        return _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000)));
+    }
+    static inline void next(__m128i &s0, __m128i &s1, __m128i &s2, __m128i &s3)
+    {
+        const __m128i t = _mm_slli_epi32(s1, 9);
+        s2 = _mm_xor_si128(s2, s0);
+        s3 = _mm_xor_si128(s3, s1);
+        s1 = _mm_xor_si128(s1, s2);
+        s0 = _mm_xor_si128(s0, s3);
+        s2 = _mm_xor_si128(s2, t);
+        s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+    }
 };
-} // namespace librandom
\ No newline at end of file
+} // namespace librandom
@@ -23,23 +23,37 @@ int main(int argc, char **argv)
     u_params.process_cmdline_args(argc, argv);
     u_params.get_folder_path();
 
+    seed_random_generators(u_params.seed);
+
     std::unique_ptr<audio_renderer> audio_engine = std::make_unique<audio_renderer>();
 
-    if (!audio_engine->init(u_params.folder_path, &u_params.max_lenght_samples)) {
+    if (!audio_engine->init(u_params.folder_path, &u_params.max_lenght_samples, static_cast<size_t>(u_params.cache_size_mb),
+                            u_params.allow_repeats, u_params.sinc_resampling)) {
         puts("Error loading files...exiting.");
         return -1;
     }
+
+    play_params params;
+    if (u_params.render_path) {
+        // headless mode - no PortAudio, graphics or compute
+        u_params.get_user_params(&params);
+        audio_engine->set_params(params);
+        ret = audio_engine->render_offline(u_params.render_path, static_cast<size_t>(u_params.render_seconds));
+        audio_engine->deinit();
+        return ret;
+    }
     // graphics is initialized afer audio engine
     visualizer graphics_engine;
-    compute_fft fft_cl{ audio_engine->get_waveform_producer() };
-    graphics_engine.init(audio_engine->get_waveform_data_buffer(), u_params.waveform_smoothing_level, &fft_cl);
+    compute_fft fft_cl{ audio_engine->get_waveform_channel() };
+    graphics_engine.init(audio_engine->get_waveform_channel(), u_params.waveform_smoothing_level, &fft_cl);
 
     if (0 != fft_cl.run_compute(graphics_engine.get_cl_sem())) {
         ret = -1;
         goto exit;
     }
 
-    u_params.get_user_params(audio_engine->get_params_buffer()->get_data(1));
+    u_params.get_user_params(&params);
+    audio_engine->set_params(params);
 
     audio_engine->start_rendering();
 
@@ -49,7 +63,7 @@ int main(int argc, char **argv)
         goto exit;
     }
 
-    u_params.run_user_loop(*audio_engine->get_data(), audio_engine->get_params_buffer());
+    u_params.run_user_loop(*audio_engine);
 
     if (audio_player.deinit_pa() != paNoError) {
         ret = -1;
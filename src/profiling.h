@@ -14,6 +14,7 @@ ZoneScopedN((name))
 #define PROFILE_FRAME_START(name) FrameMarkStart((name))
 #define PROFILE_FRAME_STOP(name) FrameMarkEnd((name))
 #define PROFILE_SET_THREAD_NAME(name) tracy::SetThreadName((name))
+#define PROFILE_PLOT(name, val) TracyPlot((name), (int64_t)(val))
 #else
 #define PROFILE_START(name)
 #define PROFILE_STOP
@@ -21,4 +22,5 @@ ZoneScopedN((name))
 #define PROFILE_FRAME_START(name)
 #define PROFILE_FRAME_STOP(name)
 #define PROFILE_SET_THREAD_NAME(name)
+#define PROFILE_PLOT(name, val)
 #endif // USE_PROFILER
\ No newline at end of file
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "constants.h"
+#include "cpu_features.h"
+
+// interpolation kernels - output i reads the source at base + phase + i * step, phase in [0, 1)
+// the source is addressed in bytes, so that planar buffers and interleaved mapped frames go through the same code.
+// The linear vector kernels do exactly the scalar arithmetic, lane by lane
+namespace resampler
+{
+inline float load_sample(const uint8_t *src, size_t stride, size_t frame)
+{
+    float v;
+    memcpy(&v, src + frame * stride, sizeof(v));
+    return v;
+}
+
+// the first output in [first, end) that reads the source at base + limit or later, end if there's none
+inline size_t first_output_at(float step, float phase, size_t first, size_t end, size_t limit)
+{
+    auto position = [step, phase](size_t i) {
+        return static_cast<size_t>(static_cast<int>(phase + static_cast<float>(i) * step));
+    };
+    size_t i = static_cast<size_t>(static_cast<float>(limit) / step); // a guess, corrected below
+    i = (i < first) ? first : ((i > end) ? end : i);
+    while (i > first && position(i - 1) >= limit)
+        i--;
+    while (i < end && position(i) < limit)
+        i++;
+    return i;
+}
+
+// outputs [first, end) that can be interpolated without reading past num_frames
+inline size_t linear_safe_end(size_t base, float step, float phase, size_t num_frames, size_t first, size_t end)
+{
+    if ((base + 1) >= num_frames)
+        return first;
+    return first_output_at(step, phase, first, end, num_frames - base - 1);
+}
+
+inline void linear_scalar(const uint8_t *src, size_t stride, size_t base, float step, float phase, float *dest, size_t first,
+                          size_t end)
+{
+    for (size_t i = first; i < end; i++) {
+        const float x = phase + float(i) * step;
+        const int y = int(x);
+        const float z = x - float(y);
+        const size_t idx = base + static_cast<size_t>(y);
+        dest[i] = load_sample(src, stride, idx) * (1.0f - z) + load_sample(src, stride, idx + 1) * z;
+    }
+}
+
+// SSE2 has no gather - the 4 pairs of taps are loaded one by one and shuffled into place
+inline void linear_sse2(const uint8_t *src, size_t stride, size_t base, float step, float phase, float *dest, size_t first,
+                        size_t end)
+{
+    const uint8_t *base_ptr = src + base * stride;
+    const __m128 d = _mm_set1_ps(step);
+    const __m128 ph = _mm_set1_ps(phase);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128i i_vec = _mm_setr_epi32(static_cast<int>(first), static_cast<int>(first + 1), static_cast<int>(first + 2),
+                                   static_cast<int>(first + 3));
+    const __m128i four = _mm_set1_epi32(4);
+    size_t i = first;
+    for (; (i + 4) <= end; i += 4) {
+        const __m128 x = _mm_add_ps(ph, _mm_mul_ps(_mm_cvtepi32_ps(i_vec), d));
+        const __m128i y = _mm_cvttps_epi32(x);
+        const __m128 z = _mm_sub_ps(x, _mm_cvtepi32_ps(y));
+        alignas(16) int32_t pos[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(pos), y);
+        const uint8_t *p0 = base_ptr + static_cast<size_t>(pos[0]) * stride;
+        const uint8_t *p1 = base_ptr + static_cast<size_t>(pos[1]) * stride;
+        const uint8_t *p2 = base_ptr + static_cast<size_t>(pos[2]) * stride;
+        const uint8_t *p3 = base_ptr + static_cast<size_t>(pos[3]) * stride;
+        const __m128 a =
+            _mm_setr_ps(load_sample(p0, 0, 0), load_sample(p1, 0, 0), load_sample(p2, 0, 0), load_sample(p3, 0, 0));
+        const __m128 b = _mm_setr_ps(load_sample(p0, stride, 1), load_sample(p1, stride, 1), load_sample(p2, stride, 1),
+                                     load_sample(p3, stride, 1));
+        const __m128 res = _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(one, z)), _mm_mul_ps(b, z));
+        _mm_storeu_ps(dest + i, res);
+        i_vec = _mm_add_epi32(i_vec, four);
+    }
+    linear_scalar(src, stride, base, step, phase, dest, i, end);
+}
+
+TARGET_AVX2 inline void linear_avx2(const uint8_t *src, size_t stride, size_t base, float step, float phase, float *dest,
+                                    size_t first, size_t end)
+{
+    const float *base_ptr = reinterpret_cast<const float *>(src + base * stride); // only used as a byte address
+    const __m256 d = _mm256_set1_ps(step);
+    const __m256 ph = _mm256_set1_ps(phase);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i byte_stride = _mm256_set1_epi32(static_cast<int>(stride));
+    __m256i i_vec = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i eight = _mm256_set1_epi32(8);
+    size_t i = first;
+    for (; (i + 8) <= end; i += 8) {
+        const __m256 x = _mm256_add_ps(ph, _mm256_mul_ps(_mm256_cvtepi32_ps(i_vec), d));
+        const __m256i y = _mm256_cvttps_epi32(x);
+        const __m256 z = _mm256_sub_ps(x, _mm256_cvtepi32_ps(y));
+        const __m256i offset = _mm256_mullo_epi32(y, byte_stride);
+        const __m256 a = _mm256_i32gather_ps(base_ptr, offset, 1);
+        const __m256 b = _mm256_i32gather_ps(base_ptr, _mm256_add_epi32(offset, byte_stride), 1);
+        const __m256 res = _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(one, z)), _mm256_mul_ps(b, z));
+        _mm256_storeu_ps(dest + i, res);
+        i_vec = _mm256_add_epi32(i_vec, eight);
+    }
+    linear_scalar(src, stride, base, step, phase, dest, i, end);
+}
+
+inline void linear(const uint8_t *src, size_t stride, size_t base, float step, float phase, float *dest, size_t first,
+                   size_t end)
+{
+    if (cpu_has_avx2_fma())
+        linear_avx2(src, stride, base, step, phase, dest, first, end);
+    else
+        linear_sse2(src, stride, base, step, phase, dest, first, end);
+}
+
+// polyphase windowed sinc - the fractional position is rounded to one of SINC_PHASES rows of SINC_TAPS coefficients,
+// output i is the dot product of a row with the source frames [idx - SINC_TAPS / 2 + 1, idx + SINC_TAPS / 2].
+// Pitching up moves the source spectrum above nyquist, so the cutoff comes down with the step - one table per band
+struct sinc_table
+{
+    static constexpr size_t num_bands = 5; // up to 0, 3, 6, 9 and 12 semitones
+    static constexpr size_t num_rows = SINC_PHASES + 1; // the last row is the first one, a frame later
+    static constexpr float cutoff = 0.9f; // of nyquist, below 1 to leave room for the transition band
+
+    alignas(CACHE_LINE_SIZE) float coefs[num_bands][num_rows][SINC_TAPS];
+    float band_steps[num_bands];
+
+    void init()
+    {
+        constexpr double pi = 3.14159265358979323846;
+        for (size_t band = 0; band < num_bands; band++) {
+            band_steps[band] = powf(2.0f, static_cast<float>(band) * 0.25f);
+            const double fc = static_cast<double>(cutoff / band_steps[band]);
+            for (size_t phase = 0; phase < num_rows; phase++) {
+                const double frac = static_cast<double>(phase) / SINC_PHASES;
+                double sum = 0.0;
+                double row[SINC_TAPS];
+                for (size_t k = 0; k < SINC_TAPS; k++) {
+                    const double t = static_cast<double>(k) - (SINC_TAPS / 2 - 1) - frac;
+                    const double x = pi * fc * t;
+                    const double sinc = (t == 0.0) ? 1.0 : sin(x) / x;
+                    const double w = 2.0 * pi * t / SINC_TAPS; // blackman, centered on the position
+                    row[k] = fc * sinc * (0.42 + 0.5 * cos(w) + 0.08 * cos(2.0 * w));
+                    sum += row[k];
+                }
+                for (size_t k = 0; k < SINC_TAPS; k++) {
+                    coefs[band][phase][k] = static_cast<float>(row[k] / sum); // unity gain at dc for every phase
+                }
+            }
+        }
+    }
+    const float *band(float step) const
+    {
+        size_t b = 0;
+        while ((b + 1) < num_bands && step > band_steps[b] * 1.0001f)
+            b++;
+        return coefs[b][0];
+    }
+};
+
+// shared by all the voices, has to be initialized before the first sinc() call
+inline sinc_table sinc_coefs;
+
+inline size_t sinc_phase(float z)
+{
+    return static_cast<size_t>(static_cast<int>(z * SINC_PHASES + 0.5f));
+}
+
+// near the ends of the source - taps outside [0, num_frames) read silence
+inline void sinc_scalar_bounded(const uint8_t *src, size_t stride, size_t num_frames, size_t base, float step,
+                                float phase, const float *table, float *dest, size_t first, size_t end)
+{
+    for (size_t i = first; i < end; i++) {
+        const float x = phase + float(i) * step;
+        const int y = int(x);
+        const float *row = table + sinc_phase(x - float(y)) * SINC_TAPS;
+        const int64_t first_tap = static_cast<int64_t>(base) + y - (SINC_TAPS / 2 - 1);
+        float acc = 0.0f;
+        for (int64_t k = 0; k < SINC_TAPS; k++) {
+            const int64_t idx = first_tap + k;
+            if (idx >= 0 && idx < static_cast<int64_t>(num_frames))
+                acc += row[k] * load_sample(src, stride, static_cast<size_t>(idx));
+        }
+        dest[i] = acc;
+    }
+}
+
+template <bool planar>
+inline __m128 load_taps_sse(const uint8_t *p, size_t stride)
+{
+    if (planar) {
+        return _mm_loadu_ps(reinterpret_cast<const float *>(p));
+    }
+    return _mm_setr_ps(load_sample(p, stride, 0), load_sample(p, stride, 1), load_sample(p, stride, 2),
+                       load_sample(p, stride, 3));
+}
+
+// 4 outputs per iteration, the 4 dot products are reduced together with a transpose
+template <bool planar>
+inline void sinc_sse2(const uint8_t *src, size_t stride, size_t base, float step, float phase, const float *table,
+                      float *dest, size_t first, size_t end)
+{
+    static_assert(SINC_TAPS == 16, "The kernel is unrolled for 16 taps.");
+    const size_t first_tap = base - (SINC_TAPS / 2 - 1); // may wrap around, only first_tap + y has to be in range
+    size_t i = first;
+    for (; (i + 4) <= end; i += 4) {
+        __m128 acc[4];
+        for (size_t j = 0; j < 4; j++) {
+            const float x = phase + float(i + j) * step;
+            const int y = int(x);
+            const float *row = table + sinc_phase(x - float(y)) * SINC_TAPS;
+            const uint8_t *p = src + (first_tap + static_cast<size_t>(y)) * stride;
+            __m128 a = _mm_mul_ps(load_taps_sse<planar>(p, stride), _mm_load_ps(row));
+            a = _mm_add_ps(a, _mm_mul_ps(load_taps_sse<planar>(p + 4 * stride, stride), _mm_load_ps(row + 4)));
+            a = _mm_add_ps(a, _mm_mul_ps(load_taps_sse<planar>(p + 8 * stride, stride), _mm_load_ps(row + 8)));
+            acc[j] = _mm_add_ps(a, _mm_mul_ps(load_taps_sse<planar>(p + 12 * stride, stride), _mm_load_ps(row + 12)));
+        }
+        _MM_TRANSPOSE4_PS(acc[0], acc[1], acc[2], acc[3]);
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_add_ps(acc[0], acc[1]), _mm_add_ps(acc[2], acc[3])));
+    }
+    for (; i < end; i++) {
+        const float x = phase + float(i) * step;
+        const int y = int(x);
+        const float *row = table + sinc_phase(x - float(y)) * SINC_TAPS;
+        const uint8_t *p = src + (first_tap + static_cast<size_t>(y)) * stride;
+        float acc = 0.0f;
+        for (size_t k = 0; k < SINC_TAPS; k++)
+            acc += row[k] * load_sample(p, stride, k);
+        dest[i] = acc;
+    }
+}
+
+// 8 outputs per iteration, interleaved sources are gathered
+template <bool planar>
+TARGET_AVX2_FMA inline void sinc_avx2(const uint8_t *src, size_t stride, size_t base, float step, float phase,
+                                      const float *table, float *dest, size_t first, size_t end)
+{
+    const size_t first_tap = base - (SINC_TAPS / 2 - 1); // may wrap around, only first_tap + y has to be in range
+    const __m256i tap_offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                   _mm256_set1_epi32(static_cast<int>(stride)));
+    size_t i = first;
+    for (; (i + 8) <= end; i += 8) {
+        __m256 acc[8];
+        for (size_t j = 0; j < 8; j++) {
+            const float x = phase + float(i + j) * step;
+            const int y = int(x);
+            const float *row = table + sinc_phase(x - float(y)) * SINC_TAPS;
+            const uint8_t *p = src + (first_tap + static_cast<size_t>(y)) * stride;
+            __m256 lo, hi;
+            if (planar) {
+                lo = _mm256_loadu_ps(reinterpret_cast<const float *>(p));
+                hi = _mm256_loadu_ps(reinterpret_cast<const float *>(p) + 8);
+            } else {
+                lo = _mm256_i32gather_ps(reinterpret_cast<const float *>(p), tap_offsets, 1);
+                hi = _mm256_i32gather_ps(reinterpret_cast<const float *>(p + 8 * stride), tap_offsets, 1);
+            }
+            acc[j] = _mm256_fmadd_ps(hi, _mm256_load_ps(row + 8), _mm256_mul_ps(lo, _mm256_load_ps(row)));
+        }
+        // lane sums of the 8 accumulators, in order
+        const __m256 h01 = _mm256_hadd_ps(acc[0], acc[1]);
+        const __m256 h23 = _mm256_hadd_ps(acc[2], acc[3]);
+        const __m256 h45 = _mm256_hadd_ps(acc[4], acc[5]);
+        const __m256 h67 = _mm256_hadd_ps(acc[6], acc[7]);
+        const __m256 h0123 = _mm256_hadd_ps(h01, h23);
+        const __m256 h4567 = _mm256_hadd_ps(h45, h67);
+        const __m256 res = _mm256_add_ps(_mm256_permute2f128_ps(h0123, h4567, 0x20), _mm256_permute2f128_ps(h0123, h4567, 0x31));
+        _mm256_storeu_ps(dest + i, res);
+    }
+    sinc_sse2<planar>(src, stride, base, step, phase, table, dest, i, end);
+}
+
+// returns the end of the outputs that fall inside the source, the caller fills the rest
+inline size_t sinc(const uint8_t *src, size_t stride, size_t num_frames, size_t base, float step, float phase, float *dest,
+                   size_t first, size_t end)
+{
+    constexpr size_t taps_before = SINC_TAPS / 2 - 1;
+    constexpr size_t taps_after = SINC_TAPS / 2;
+    const float *table = sinc_coefs.band(step);
+    const size_t valid_end = (base < num_frames) ? first_output_at(step, phase, first, end, num_frames - base) : first;
+    size_t lo = (base < taps_before) ? first_output_at(step, phase, first, valid_end, taps_before - base) : first;
+    size_t hi = ((base + taps_after) < num_frames) ? first_output_at(step, phase, lo, valid_end, num_frames - base - taps_after) : lo;
+    lo = (lo < valid_end) ? lo : valid_end;
+    hi = (hi < lo) ? lo : hi;
+
+    sinc_scalar_bounded(src, stride, num_frames, base, step, phase, table, dest, first, lo);
+    const bool planar = (stride == sizeof(float));
+    if (cpu_has_avx2_fma()) {
+        if (planar)
+            sinc_avx2<true>(src, stride, base, step, phase, table, dest, lo, hi);
+        else
+            sinc_avx2<false>(src, stride, base, step, phase, table, dest, lo, hi);
+    } else {
+        if (planar)
+            sinc_sse2<true>(src, stride, base, step, phase, table, dest, lo, hi);
+        else
+            sinc_sse2<false>(src, stride, base, step, phase, table, dest, lo, hi);
+    }
+    sinc_scalar_bounded(src, stride, num_frames, base, step, phase, table, dest, hi, valid_end);
+    return valid_end;
+}
+} // namespace resampler
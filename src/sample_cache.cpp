@@ -0,0 +1,107 @@
+#include "sample_cache.h"
+
+#include <stdio.h>
+
+#include "profiling.h"
+
+bool cached_sample::load(const std::string &path)
+{
+    const uint8_t *channels[NUM_CHANNELS];
+    size_t num_channels;
+    if (mapping.open(path.c_str()) && mapping.is_float32()) {
+        num_channels = mapping.num_channels();
+        for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+            channels[ch] = mapping.frames() + ((ch < num_channels) ? ch : 0) * sizeof(float);
+        }
+        view.stride = num_channels * sizeof(float);
+        view.num_frames = mapping.num_frames();
+        // charged like a decoded file - otherwise mappings and their touched pages are never evicted
+        size_bytes = view.num_frames * num_channels * sizeof(float);
+    } else {
+        mapping.close();
+        if (!audio_file.load(path) || !audio_file.getNumChannels()) {
+            return false;
+        }
+        num_channels = static_cast<size_t>(audio_file.getNumChannels());
+        for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+            channels[ch] = reinterpret_cast<const uint8_t *>(audio_file.samples[(ch < num_channels) ? ch : 0].data());
+        }
+        view.stride = sizeof(float);
+        view.num_frames = static_cast<size_t>(audio_file.getNumSamplesPerChannel());
+        size_bytes = view.num_frames * num_channels * sizeof(float);
+    }
+    memcpy(view.channels, channels, sizeof(channels));
+    view.num_channels = (num_channels < NUM_CHANNELS) ? num_channels : NUM_CHANNELS;
+    return true;
+}
+
+void sample_cache::init(size_t budget_bytes)
+{
+    clear();
+    _budget_bytes = budget_bytes;
+}
+
+void sample_cache::resize(size_t num_files)
+{
+    _entries.resize(num_files);
+}
+
+void sample_cache::clear()
+{
+    _entries.clear();
+    _used_bytes = 0;
+}
+
+cached_sample *sample_cache::acquire(size_t file_id, const std::string &path, size_t size_bytes)
+{
+    cached_sample *entry = _entries[file_id].get();
+    if (entry) {
+        _hits++;
+    } else {
+        PROFILE_START("sample_cache::acquire - miss");
+        _misses++;
+        make_room(size_bytes);
+        std::unique_ptr<cached_sample> new_entry = std::make_unique<cached_sample>();
+        bool res = new_entry->load(path); res;
+        assert(res);
+        _used_bytes += new_entry->size_bytes;
+        entry = new_entry.get();
+        _entries[file_id] = std::move(new_entry);
+        PROFILE_STOP("sample_cache::acquire - miss");
+    }
+    entry->last_used = ++_clock;
+    entry->ref_count.fetch_add(1, std::memory_order_relaxed);
+    PROFILE_PLOT("Sample cache, MB", _used_bytes >> 20);
+    return entry;
+}
+
+void sample_cache::make_room(size_t size_bytes)
+{
+    // the budget may still be exceeded, if everything resident is being played
+    while ((_used_bytes + size_bytes) > _budget_bytes) {
+        size_t lru_id = _entries.size();
+        uint64_t lru_time = UINT64_MAX;
+        for (size_t i = 0, sz = _entries.size(); i < sz; i++) {
+            const cached_sample *entry = _entries[i].get();
+            if (entry && (entry->last_used < lru_time) && !entry->ref_count.load(std::memory_order_acquire)) {
+                lru_id = i;
+                lru_time = entry->last_used;
+            }
+        }
+        if (lru_id == _entries.size()) {
+            break;
+        }
+        _used_bytes -= _entries[lru_id]->size_bytes;
+        _entries[lru_id].reset();
+        _evictions++;
+    }
+}
+
+void sample_cache::print_stats() const
+{
+    const uint64_t total = _hits + _misses;
+    printf("Sample cache: %llu hits, %llu misses (%.1f%% hit rate), %llu evictions, %zu of %zu MB used\n",
+           static_cast<unsigned long long>(_hits), static_cast<unsigned long long>(_misses),
+           total ? 100.0 * static_cast<double>(_hits) / static_cast<double>(total) : 0.0,
+           static_cast<unsigned long long>(_evictions), _used_bytes >> 20, _budget_bytes >> 20);
+}
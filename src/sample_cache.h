@@ -0,0 +1,94 @@
+#pragma once
+
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "AudioFile.h"
+#include "constants.h"
+#include "wav_file.h"
+
+// where the frames of a sample live - planar decoded buffers or interleaved mapped frames
+// mapped data is only byte aligned, so samples are read through memcpy (a plain unaligned load on x86)
+struct sample_view
+{
+    const uint8_t *channels[NUM_CHANNELS];
+    size_t stride; // bytes between two frames of a channel
+    size_t num_frames;
+    size_t num_channels; // only the first NUM_CHANNELS are played
+
+    float at(size_t ch, size_t frame) const
+    {
+        float v;
+        memcpy(&v, channels[ch] + frame * stride, sizeof(v));
+        return v;
+    }
+    bool is_planar() const
+    {
+        return stride == sizeof(float); // contiguous, mono mapped files included
+    }
+    bool is_stereo() const
+    {
+        return num_channels > 1;
+    }
+};
+
+struct cached_sample
+{
+    wav_mapping mapping; // fp32 files are played in place
+    AudioFile<float> audio_file; // anything else gets decoded
+    sample_view view;
+    size_t size_bytes; // decoded frames, or the mapped frames - both count against the budget
+    uint64_t last_used;
+    std::atomic<int32_t> ref_count; // held by the file queue, then by the voice playing it
+
+    cached_sample() : view{}, size_bytes(0), last_used(0), ref_count(0)
+    {
+    }
+
+    bool load(const std::string &path);
+};
+
+// decoded samples stay resident until the memory budget forces the least recently used unreferenced ones out
+// only the streamer thread inserts and evicts, any thread may release a reference
+class sample_cache
+{
+    std::vector<std::unique_ptr<cached_sample>> _entries; // by file id, null if not resident
+    size_t _budget_bytes;
+    size_t _used_bytes;
+    uint64_t _clock;
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _evictions;
+
+  public:
+    sample_cache() : _budget_bytes(0), _used_bytes(0), _clock(0), _hits(0), _misses(0), _evictions(0)
+    {
+    }
+
+    // C5220
+    sample_cache(const sample_cache&) = delete;
+    sample_cache& operator=(const sample_cache&) = delete;
+    sample_cache(sample_cache&&) = delete;
+    sample_cache& operator=(sample_cache&&) = delete;
+
+    void init(size_t budget_bytes);
+    void resize(size_t num_files);
+    void clear();
+    // returns a referenced entry, decoding the file on a miss
+    cached_sample *acquire(size_t file_id, const std::string &path, size_t size_bytes);
+    static void release(const cached_sample *sample)
+    {
+        const_cast<cached_sample *>(sample)->ref_count.fetch_sub(1, std::memory_order_release);
+    }
+
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+    void print_stats() const;
+
+  private:
+    void make_room(size_t size_bytes);
+};
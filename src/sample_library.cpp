@@ -0,0 +1,181 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+
+#include "constants.h"
+#include "sample_library.h"
+#include "profiling.h"
+
+#define MANIFEST_VERSION 1
+
+static void get_library_file_path(const char *folder_path, const char *name, char (&path)[MAX_PATH])
+{
+    memset(path, 0, sizeof(path));
+    strcpy_s(path, folder_path);
+    strcat_s(path, "\\");
+    strcat_s(path, name);
+}
+
+static void read_manifest(const char *folder_path, std::unordered_map<std::string, library_entry> &manifest)
+{
+    char path[MAX_PATH];
+    get_library_file_path(folder_path, LIBRARY_MANIFEST_NAME, path);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return;
+    }
+    char line[MAX_PATH + 128];
+    int version = 0;
+    if (fgets(line, sizeof(line), fp) && sscanf(line, "manifest %d", &version) == 1 && version == MANIFEST_VERSION) {
+        while (fgets(line, sizeof(line), fp)) {
+            library_entry entry;
+            unsigned long long file_size, write_time, num_frames;
+            unsigned int format_tag, num_channels, sample_rate, bits_per_sample, block_align;
+            int name_offset = 0;
+            if (sscanf(line, "%llu %llu %u %u %u %u %u %llu %n", &file_size, &write_time, &format_tag, &num_channels,
+                       &sample_rate, &bits_per_sample, &block_align, &num_frames, &name_offset) != 8 || !name_offset) {
+                continue;
+            }
+            entry.name = line + name_offset;
+            while (!entry.name.empty() && (entry.name.back() == '\n' || entry.name.back() == '\r')) {
+                entry.name.pop_back();
+            }
+            entry.file_size = file_size;
+            entry.write_time = write_time;
+            entry.info.format_tag = static_cast<uint16_t>(format_tag);
+            entry.info.num_channels = static_cast<uint16_t>(num_channels);
+            entry.info.sample_rate = sample_rate;
+            entry.info.bits_per_sample = static_cast<uint16_t>(bits_per_sample);
+            entry.info.block_align = static_cast<uint16_t>(block_align);
+            entry.info.num_frames = static_cast<size_t>(num_frames);
+            manifest[entry.name] = entry;
+        }
+    }
+    fclose(fp);
+}
+
+static bool write_manifest(const char *folder_path, const std::vector<library_entry> &entries)
+{
+    char path[MAX_PATH];
+    get_library_file_path(folder_path, LIBRARY_MANIFEST_NAME, path);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "manifest %d\n", MANIFEST_VERSION);
+    for (const library_entry &entry : entries) {
+        const wav_info &info = entry.info;
+        fprintf(fp, "%llu %llu %u %u %u %u %u %llu %s\n", static_cast<unsigned long long>(entry.file_size),
+                static_cast<unsigned long long>(entry.write_time), info.format_tag, info.num_channels, info.sample_rate,
+                info.bits_per_sample, info.block_align, static_cast<unsigned long long>(info.num_frames),
+                entry.name.c_str());
+    }
+    return !fclose(fp);
+}
+
+// header parsing is mostly waiting for the disk, so every core gets a share of the files
+static void parse_headers(const char *folder_path, std::vector<library_entry> &entries, const std::vector<size_t> &pending)
+{
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < pending.size(); i = next.fetch_add(1)) {
+            library_entry &entry = entries[pending[i]];
+            char path[MAX_PATH];
+            get_library_file_path(folder_path, entry.name.c_str(), path);
+            if (!wav_mapping::probe(path, entry.info)) {
+                entry.info = wav_info{};
+            }
+        }
+    };
+    const size_t num_cores = static_cast<size_t>(std::thread::hardware_concurrency());
+    const size_t num_workers = (num_cores < pending.size()) ? num_cores : pending.size();
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < num_workers; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+}
+
+bool scan_library(const char *folder_path, std::vector<library_entry> &entries)
+{
+    char path[MAX_PATH];
+    memset(path, 0, sizeof(path));
+    strcpy_s(path, folder_path);
+    strcat_s(path, "\\*.wav");
+
+    WIN32_FIND_DATA fd;
+    HANDLE h_find = ::FindFirstFile(path, &fd);
+    if (h_find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    PROFILE_START("scan_library");
+    std::unordered_map<std::string, library_entry> manifest;
+    read_manifest(folder_path, manifest);
+
+    std::vector<size_t> pending; // new or changed since the manifest was written
+    do {
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            library_entry entry;
+            entry.name = fd.cFileName;
+            entry.file_size = (uint64_t(fd.nFileSizeHigh) << 32) | fd.nFileSizeLow;
+            entry.write_time = (uint64_t(fd.ftLastWriteTime.dwHighDateTime) << 32) | fd.ftLastWriteTime.dwLowDateTime;
+            entry.info = wav_info{};
+            auto it = manifest.find(entry.name);
+            if (it != manifest.end() && it->second.file_size == entry.file_size &&
+                it->second.write_time == entry.write_time) {
+                entry.info = it->second.info;
+            } else {
+                pending.push_back(entries.size());
+            }
+            entries.push_back(entry);
+        }
+    } while (::FindNextFile(h_find, &fd));
+    ::FindClose(h_find);
+
+    parse_headers(folder_path, entries, pending);
+
+    // deleted files only show up as a size mismatch
+    if (!pending.empty() || manifest.size() != entries.size()) {
+        if (!write_manifest(folder_path, entries)) {
+            puts("Failed to write the library manifest, the next scan will parse all the headers again.");
+        }
+    }
+    printf("Library: %zu files, %zu headers parsed, %zu taken from the manifest\n", entries.size(), pending.size(),
+           entries.size() - pending.size());
+    PROFILE_STOP("scan_library");
+    return !entries.empty();
+}
+
+bool read_library_weights(const char *folder_path, std::unordered_map<std::string, float> &weights)
+{
+    char path[MAX_PATH];
+    get_library_file_path(folder_path, LIBRARY_WEIGHTS_NAME, path);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return false;
+    }
+    char line[MAX_PATH + 32];
+    while (fgets(line, sizeof(line), fp)) {
+        float weight;
+        int name_offset = 0;
+        if (line[0] == '#' || sscanf(line, "%f %n", &weight, &name_offset) != 1 || !name_offset) {
+            continue;
+        }
+        std::string name = line + name_offset;
+        while (!name.empty() && (name.back() == '\n' || name.back() == '\r' || name.back() == ' ')) {
+            name.pop_back();
+        }
+        if (!name.empty()) {
+            weights[name] = weight;
+        }
+    }
+    fclose(fp);
+    printf("Library: %zu weights read from %s\n", weights.size(), LIBRARY_WEIGHTS_NAME);
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "wav_file.h"
+
+struct library_entry
+{
+    std::string name; // inside the library folder
+    uint64_t file_size;
+    uint64_t write_time; // FILETIME ticks
+    wav_info info;       // num_frames is 0 if the file can't be played
+};
+
+// lists the WAV files of a folder without decoding them. Headers are parsed on all cores and remembered
+// in a manifest next to the files, so later launches only look at new or changed files
+bool scan_library(const char *folder_path, std::vector<library_entry> &entries);
+
+
+// optional per-file weights, "<weight> <file name>" per line - false if the folder has no weights file
+bool read_library_weights(const char *folder_path, std::unordered_map<std::string, float> &weights);
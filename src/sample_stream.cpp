@@ -0,0 +1,104 @@
+#include "sample_stream.h"
+
+#include <thread>
+
+#include "profiling.h"
+
+bool sample_stream::open(const std::string &path, semaphore *wake)
+{
+    assert(!in_use());
+    if (!_mapping.open(path.c_str())) {
+        return false;
+    }
+    _num_channels = _mapping.num_channels();
+    _num_channels = (_num_channels < NUM_CHANNELS) ? _num_channels : NUM_CHANNELS;
+    for (auto &chunk : _chunks) {
+        for (auto &channel : chunk) {
+            channel.resize(chunk_size); // only allocates on the first use of this stream
+        }
+    }
+    _wake = wake;
+    _underruns.store(0, std::memory_order_relaxed);
+    _play_chunk.store(0, std::memory_order_relaxed);
+    _loaded_chunk[0].store(-1, std::memory_order_relaxed);
+    _loaded_chunk[1].store(-1, std::memory_order_relaxed);
+    load_chunk(0);
+    load_chunk(1);
+    _in_use.store(true, std::memory_order_release);
+    return true;
+}
+
+void sample_stream::service()
+{
+    if (!in_use()) {
+        return;
+    }
+    // the render thread can move on to a chunk before it's loaded, when the streamer falls behind -
+    // the one being played comes first, only then the one after it
+    const int64_t play_chunk = _play_chunk.load(std::memory_order_acquire);
+    if (_loaded_chunk[play_chunk & 1].load(std::memory_order_relaxed) != play_chunk) {
+        load_chunk(play_chunk);
+    }
+    const int64_t next_chunk = play_chunk + 1;
+    if (_loaded_chunk[next_chunk & 1].load(std::memory_order_relaxed) != next_chunk) {
+        load_chunk(next_chunk);
+    }
+}
+
+void sample_stream::load_chunk(int64_t chunk)
+{
+    const size_t first_frame = static_cast<size_t>(chunk) * STREAM_CHUNK_FRAMES;
+    if (first_frame >= _mapping.num_frames()) {
+        return;
+    }
+    PROFILE_START("sample_stream::load_chunk");
+    std::atomic<int64_t> &loaded = _loaded_chunk[chunk & 1];
+    loaded.store(-1, std::memory_order_relaxed);
+    // the history comes from the previous chunk, or is silence before the file starts
+    const size_t history = chunk ? STREAM_HISTORY_FRAMES : 0;
+    const size_t frames_left = _mapping.num_frames() - first_frame + history;
+    const size_t buffer_frames = chunk_size - STREAM_HISTORY_FRAMES + history;
+    const size_t num_frames = (frames_left < buffer_frames) ? frames_left : buffer_frames;
+    std::array<std::vector<float>, NUM_CHANNELS> &buffer = _chunks[chunk & 1];
+    float *dest[NUM_CHANNELS];
+    for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+        dest[ch] = buffer[ch].data() + STREAM_HISTORY_FRAMES - history;
+        if (!history)
+            memset(buffer[ch].data(), 0, sizeof(float) * STREAM_HISTORY_FRAMES);
+    }
+    _mapping.read_frames(first_frame - history, num_frames, dest, _num_channels);
+    loaded.store(chunk, std::memory_order_release);
+    PROFILE_STOP("sample_stream::load_chunk");
+}
+
+bool sample_stream::view(size_t first_frame, sample_view &view, size_t &offset, bool wait)
+{
+    const int64_t chunk = static_cast<int64_t>(first_frame / STREAM_CHUNK_FRAMES);
+    if (_play_chunk.load(std::memory_order_relaxed) != chunk) {
+        // the previous buffer is free now - ask for the chunk after this one
+        _play_chunk.store(chunk, std::memory_order_release);
+        _wake->signal();
+    }
+    if (_loaded_chunk[chunk & 1].load(std::memory_order_acquire) != chunk) {
+        if (!wait) {
+            _underruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // the streamer has been woken up for this chunk already
+        while (_loaded_chunk[chunk & 1].load(std::memory_order_acquire) != chunk) {
+            std::this_thread::yield();
+        }
+    }
+    const size_t chunk_first_frame = static_cast<size_t>(chunk) * STREAM_CHUNK_FRAMES;
+    // the view starts with the history
+    const size_t frames_left = _mapping.num_frames() - chunk_first_frame + STREAM_HISTORY_FRAMES;
+    const std::array<std::vector<float>, NUM_CHANNELS> &buffer = _chunks[chunk & 1];
+    for (size_t ch = 0; ch < NUM_CHANNELS; ch++) {
+        view.channels[ch] = reinterpret_cast<const uint8_t *>(buffer[(ch < _num_channels) ? ch : 0].data());
+    }
+    view.stride = sizeof(float);
+    view.num_frames = (frames_left < chunk_size) ? frames_left : chunk_size;
+    view.num_channels = _num_channels;
+    offset = first_frame - chunk_first_frame + STREAM_HISTORY_FRAMES;
+    return true;
+}
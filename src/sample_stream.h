@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "sample_cache.h"
+#include "semaphore.h"
+
+// a long file played by one voice - the streamer thread converts it chunk by chunk into two buffers,
+// one chunk ahead of the play position, so only 2 chunks per voice are ever resident
+class sample_stream
+{
+    // chunk k holds frames [k * STREAM_CHUNK_FRAMES - STREAM_HISTORY_FRAMES, (k + 1) * STREAM_CHUNK_FRAMES + STREAM_GUARD_FRAMES),
+    // the history and the guard let a block that starts in chunk k be resampled from chunk k alone.
+    // Chunk 0 starts with silence where the history would be
+    static constexpr size_t chunk_size = STREAM_HISTORY_FRAMES + STREAM_CHUNK_FRAMES + STREAM_GUARD_FRAMES;
+
+    wav_mapping _mapping;
+    std::array<std::array<std::vector<float>, NUM_CHANNELS>, 2> _chunks;
+    std::array<std::atomic<int64_t>, 2> _loaded_chunk; // per buffer, -1 while (re)loading
+    std::atomic<int64_t> _play_chunk;                  // written by the render thread
+    std::atomic<bool> _in_use;
+    std::atomic<uint32_t> _underruns;
+    semaphore *_wake; // the streamer's
+    size_t _num_channels;
+
+  public:
+    sample_stream() : _play_chunk(0), _in_use(false), _underruns(0), _wake(nullptr), _num_channels(0)
+    {
+        _loaded_chunk[0].store(-1, std::memory_order_relaxed);
+        _loaded_chunk[1].store(-1, std::memory_order_relaxed);
+    }
+
+    // C5220
+    sample_stream(const sample_stream&) = delete;
+    sample_stream& operator=(const sample_stream&) = delete;
+    sample_stream(sample_stream&&) = delete;
+    sample_stream& operator=(sample_stream&&) = delete;
+
+    // streamer thread - opens the file and preloads the first two chunks
+    bool open(const std::string &path, semaphore *wake);
+    // streamer thread - loads the chunk being played and the one after it, if they're missing
+    void service();
+    bool in_use() const { return _in_use.load(std::memory_order_acquire); }
+
+    // render thread - false if the chunk holding first_frame isn't loaded yet, unless told to wait for it
+    bool view(size_t first_frame, sample_view &view, size_t &offset, bool wait = false);
+    void release()
+    {
+        _in_use.store(false, std::memory_order_release);
+    }
+
+    size_t num_frames() const { return _mapping.num_frames(); }
+    size_t num_channels() const { return _num_channels; }
+    uint32_t underruns() const { return _underruns.load(std::memory_order_relaxed); }
+
+  private:
+    void load_chunk(int64_t chunk);
+};
+
+// what the streamer hands to a voice - a resident sample or a stream, never both
+struct note_source
+{
+    cached_sample *sample = nullptr;
+    sample_stream *stream = nullptr;
+};
@@ -1,62 +1,143 @@
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+#include <emmintrin.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // _WIN32
+
+// the kernel is entered only to block or to wake up a blocked thread
+inline void futex_wait(std::atomic<int32_t> *addr, int32_t expected)
+{
+#ifdef _WIN32
+	WaitOnAddress(reinterpret_cast<volatile VOID *>(addr), &expected, sizeof(expected), INFINITE);
+#else
+	syscall(SYS_futex, reinterpret_cast<int32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#endif // _WIN32
+}
+
+inline void futex_wake_one(std::atomic<int32_t> *addr)
+{
+#ifdef _WIN32
+	WakeByAddressSingle(reinterpret_cast<PVOID>(addr));
+#else
+	syscall(SYS_futex, reinterpret_cast<int32_t *>(addr), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif // _WIN32
+}
+
+inline void futex_wake_all(std::atomic<int32_t> *addr)
+{
+#ifdef _WIN32
+	WakeByAddressAll(reinterpret_cast<PVOID>(addr));
+#else
+	syscall(SYS_futex, reinterpret_cast<int32_t *>(addr), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#endif // _WIN32
+}
+
+// spinning before blocking only pays off if the signaling thread can run at the same time
+inline int semaphore_spin_count()
+{
+	static const int num_spins = (std::thread::hardware_concurrency() > 1) ? 64 : 0;
+	return num_spins;
+}
+
+// binary semaphore
 class semaphore
 {
-	std::mutex m;
-	std::condition_variable cv;
-	volatile int ready = 0;
+	static constexpr int32_t signaled = 1;
+	static constexpr int32_t not_signaled = 0;
+	static constexpr int32_t waiting = -1; // not signaled, somebody may be blocked
+
+	std::atomic<int32_t> state{not_signaled};
 public:
-	void wait() 
+	void wait()
 	{
-		std::unique_lock<std::mutex> lock(m);
-		cv.wait(lock, [this]() { return this->ready; });
-		this->ready = 0;
+		// fast path - already signaled, or signaled while spinning
+		for (int i = 0, num_spins = semaphore_spin_count(); i <= num_spins; i++) {
+			int32_t s = signaled;
+			if (state.compare_exchange_strong(s, not_signaled, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return;
+			}
+			_mm_pause();
+		}
+		// after having blocked, leave the "waiting" mark in place - other threads might still be blocked
+		for (int32_t next = not_signaled;; next = waiting) {
+			int32_t s = state.load(std::memory_order_relaxed);
+			if (s == signaled) {
+				if (state.compare_exchange_weak(s, next, std::memory_order_acquire, std::memory_order_relaxed)) {
+					return;
+				}
+				continue;
+			}
+			if (s == not_signaled && !state.compare_exchange_weak(s, waiting, std::memory_order_relaxed, std::memory_order_relaxed)) {
+				continue;
+			}
+			futex_wait(&state, waiting);
+		}
 	}
 	void signal()
 	{
-		{
-			std::unique_lock<std::mutex> lock(m);
-			ready = 1;
+		if (state.exchange(signaled, std::memory_order_release) == waiting) {
+			futex_wake_one(&state);
 		}
-		cv.notify_one();
 	}
 };
 
 class semaphore_counting
 {
-	std::mutex m;
-	std::condition_variable cv;
-	volatile int counter = 0;
+	std::atomic<int32_t> counter{0};
+	std::atomic<int32_t> num_waiters{0};
 	int max_count = 1; // binary semaphore by default
 public:
 	void set_max_count(int count) {
 		max_count = count;
 	}
 	void wait() {
-		std::unique_lock<std::mutex> lock(m);
-		if (counter == 0) {
-			cv.wait(lock, [this]() { return counter != 0; });
-			counter--;
+		for (int i = 0, num_spins = semaphore_spin_count(); i <= num_spins; i++) {
+			if (try_acquire()) {
+				return;
+			}
+			_mm_pause();
+		}
+		// seq_cst - pairs with the counter update and num_waiters check in signal()
+		num_waiters.fetch_add(1);
+		while (!try_acquire()) {
+			futex_wait(&counter, 0);
 		}
+		num_waiters.fetch_sub(1, std::memory_order_relaxed);
 	}
 	void signal() {
-		{
-			std::unique_lock<std::mutex> lock(m);
-			if (counter < max_count) {
-				counter++;
-			}
-		}
-		cv.notify_one();
+		signal(1);
 	}
 	void signal(int count) {
-		{
-			std::unique_lock<std::mutex> lock(m);
-			const int new_count = counter + count;
-			counter = (new_count < max_count) ? new_count : max_count;
+		int32_t c = counter.load(std::memory_order_relaxed);
+		int32_t new_count;
+		do {
+			new_count = ((c + count) < max_count) ? (c + count) : max_count;
+		} while (!counter.compare_exchange_weak(c, new_count));
+		if (num_waiters.load()) {
+			if (count == 1)
+				futex_wake_one(&counter);
+			else
+				futex_wake_all(&counter);
 		}
-		cv.notify_all();
 	}
-};
\ No newline at end of file
+private:
+	bool try_acquire() {
+		int32_t c = counter.load(std::memory_order_relaxed);
+		while (c > 0) {
+			if (counter.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
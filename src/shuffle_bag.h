@@ -0,0 +1,56 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// random draws without repeats - every id comes up once per cycle, O(1) per draw
+// the undrawn ids are kept at the front of the array, a draw swaps the picked one behind them (incremental Fisher-Yates)
+class shuffle_bag
+{
+    std::vector<uint32_t> _ids;
+    size_t _left; // ids still in the current cycle: _ids[0, _left)
+
+  public:
+    shuffle_bag() : _left(0)
+    {
+    }
+
+    void init(size_t num_ids)
+    {
+        assert(num_ids <= UINT32_MAX);
+        _ids.resize(num_ids);
+        for (size_t i = 0; i < num_ids; i++) {
+            _ids[i] = static_cast<uint32_t>(i);
+        }
+        _left = num_ids;
+    }
+
+    // rnd - uniformly distributed, at least as wide as the number of ids
+    uint32_t draw(uint32_t rnd)
+    {
+        const size_t size = _ids.size();
+        assert(size);
+        size_t range = _left;
+        if (!_left) {
+            // new cycle - the last id of the previous one sits at the front, keep it out of the first draw
+            // so that it doesn't repeat across the cycle boundary
+            std::swap(_ids[0], _ids[size - 1]);
+            _left = size;
+            range = (size > 1) ? (size - 1) : size;
+        }
+        const size_t idx = rnd % range;
+        const uint32_t id = _ids[idx];
+        _ids[idx] = _ids[_left - 1];
+        _ids[_left - 1] = id;
+        _left--;
+        return id;
+    }
+
+    size_t size() const
+    {
+        return _ids.size();
+    }
+};
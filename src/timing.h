@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+inline int64_t timestamp_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// accumulated by a single thread, read once that thread is done
+struct timing_stats
+{
+    static constexpr int num_buckets = 32; // log2(ns) histogram, for the percentiles
+
+    uint64_t count = 0;
+    int64_t total_ns = 0;
+    int64_t max_ns = 0;
+    uint64_t histogram[num_buckets] = {};
+
+    void add(int64_t ns)
+    {
+        ns = (ns > 0) ? ns : 0;
+        count++;
+        total_ns += ns;
+        max_ns = (ns > max_ns) ? ns : max_ns;
+        int bucket = 0;
+        while ((bucket < num_buckets - 1) && (ns >> (bucket + 1)))
+            bucket++;
+        histogram[bucket]++;
+    }
+    // upper bound of the bucket holding the given percentile
+    int64_t percentile_ns(double p) const
+    {
+        const uint64_t target = static_cast<uint64_t>(static_cast<double>(count) * p);
+        uint64_t acc = 0;
+        for (int i = 0; i < num_buckets; i++) {
+            acc += histogram[i];
+            if (acc > target)
+                return int64_t(2) << i;
+        }
+        return max_ns;
+    }
+    void print(const char *name) const
+    {
+        if (!count)
+            return;
+        printf("%s: avg %.1f us, p99 < %.1f us, max %.1f us (%llu samples)\n", name,
+               static_cast<double>(total_ns) / static_cast<double>(count) * 1e-3, static_cast<double>(percentile_ns(0.99)) * 1e-3,
+               static_cast<double>(max_ns) * 1e-3, static_cast<unsigned long long>(count));
+    }
+};
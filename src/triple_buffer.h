@@ -1,73 +1,74 @@
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
 #include <array>
+#include <atomic>
+#include <stdint.h>
 
 #include "constants.h"
 
-template <typename T>
-class triple_buffer {
-	std::array<T, 3> data;
-	struct {
-		T *front_buffer_ptr;
-		T *back_buffer_ptr;
-		volatile T *middle_buffer_ptr;
-	};
-	volatile LONG has_new_data;
+// lock-free triple buffering of indices 0..2, one producer and one consumer
+// the shared word packs the middle index with a "new data" bit, the producer and consumer indices
+// live on their own cache lines, so the two sides only ever meet on the shared word
+class triple_indices {
+	static constexpr uint32_t index_mask = 0x3;
+	static constexpr uint32_t dirty_bit = 0x4;
+
+	alignas(CACHE_LINE_SIZE) uint32_t back_idx;			// producer only
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> middle;	// shared
+	alignas(CACHE_LINE_SIZE) uint32_t front_idx;			// consumer only
+
 public:
-	triple_buffer() : has_new_data(1)
+	triple_indices() : back_idx(0), middle(1 | dirty_bit), front_idx(2) {}
+
+	// C5220
+	triple_indices(const triple_indices&) = delete;
+	triple_indices& operator=(const triple_indices&) = delete;
+
+	uint64_t get_back_buffer() const { return back_idx; }
+	uint64_t get_front_buffer() const { return front_idx; }
+	void publish()
 	{
-		front_buffer_ptr = &data[2];
-		back_buffer_ptr = &data[0];
-		middle_buffer_ptr = &data[1];
+		// release - the back buffer contents become visible together with the index
+		back_idx = middle.exchange(back_idx | dirty_bit, std::memory_order_acq_rel) & index_mask;
 	}
-	T* get_data(size_t id) { return &data[id]; }
-	T* get_back_buffer() { return back_buffer_ptr; }
-	void publish() 
+	uint64_t consume()
 	{
-		back_buffer_ptr = (T*)InterlockedExchange64((volatile LONG64*)&middle_buffer_ptr, reinterpret_cast<LONG64>(back_buffer_ptr));
-		InterlockedExchange(&has_new_data, 1); // InterlockedExchange is used for serialization
+		try_consume();
+		return front_idx;
 	}
-	T* const consume()
+	bool try_consume()
 	{
-		if (InterlockedExchange(&has_new_data, 0)) {
-			front_buffer_ptr = (T*)InterlockedExchange64((volatile LONG64*)&middle_buffer_ptr, reinterpret_cast<LONG64>(front_buffer_ptr));
+		if (!(middle.load(std::memory_order_relaxed) & dirty_bit)) {
+			return false;
 		}
-		return front_buffer_ptr;
-	}
-	T* const try_consume()
-	{
-		if (InterlockedExchange(&has_new_data, 0)) {
-			front_buffer_ptr = (T*)InterlockedExchange64((volatile LONG64*)&middle_buffer_ptr, reinterpret_cast<LONG64>(front_buffer_ptr));
-			return front_buffer_ptr;
-		}
-		return nullptr;
+		// acquire - pairs with publish()
+		front_idx = middle.exchange(front_idx, std::memory_order_acq_rel) & index_mask;
+		return true;
 	}
 };
 
-class triple_indices {
-	std::array<volatile uint64_t, 3> data;
-	volatile LONG has_new_data;
-
+template <typename T>
+class triple_buffer {
+	struct alignas(CACHE_LINE_SIZE) slot {
+		T value;
+	};
+	std::array<slot, 3> data;
+	triple_indices indices;
 public:
-	triple_indices() : has_new_data(1)
+	triple_buffer() = default;
+
+	T* get_data(size_t id) { return &data[id].value; }
+	T* get_back_buffer() { return &data[indices.get_back_buffer()].value; }
+	void publish() 
 	{
-		data[0] = 0; // back buffer
-		data[1] = 1; // shared buffer
-		data[2] = 2; // front buffer
+		indices.publish();
 	}
-	uint64_t get_back_buffer() { return data[0]; }
-	void publish()
+	T* consume()
 	{
-		data[0] = (uint64_t)InterlockedExchange64((volatile LONG64*)(&data[1]), static_cast<LONG64>(data[0]));
-		InterlockedExchange(&has_new_data, 1); // InterlockedExchange is used for serialization
+		return &data[indices.consume()].value;
 	}
-	uint64_t const consume()
+	T* try_consume()
 	{
-		if (InterlockedExchange(&has_new_data, 0)) {
-			data[2] = (uint64_t)InterlockedExchange64((volatile LONG64*)(&data[1]), static_cast<LONG64>(data[2]));
-		}
-		return data[2];
+		return indices.try_consume() ? &data[indices.get_front_buffer()].value : nullptr;
 	}
-};
\ No newline at end of file
+};
@@ -72,12 +72,21 @@ void user_params::get_user_params(play_params *data)
     value = clamp_input(get_input(DEFAULT_LPF_Q_DEVIATION), MIN_LPF_Q_DEVIATION, MAX_LPF_Q_DEVIATION);
     printf("%d\n", value);
     const float lpf_q = static_cast<float>(value);
-    puts("\nEnter non-zero value to use LFO for volume modulation.");
+
+    while ((getchar()) != '\n'); // flush stdin
+
+    printf("\nRandomize the filter type and slope? [y/n]\t");
+    ch = static_cast<char>(getchar());
+    const bool rnd_filter = (ch == 'y' || ch == 'Y');
+    printf("%c\n", rnd_filter ? 'y' : 'n');
+
+    puts("\nEnter non-zero value to use LFO for volume or filter cutoff modulation.");
     printf("Enter LFO modulation frequency in Hz [1...10]:\t");
     value = get_input(DEFAULT_LFO_FREQ);
     const bool use_lfo = !!value;
     float lfo_freq = 0.0f;
     float lfo_amount = 0.0f;
+    bool lfo_filter = false;
     if (use_lfo) {
         value = clamp_input(value, MIN_LFO_FREQ, MAX_LFO_FREQ);
         printf("%d\n", value);
@@ -86,6 +95,13 @@ void user_params::get_user_params(play_params *data)
         value = clamp_input(get_input(DEFAULT_LFO_AMOUNT), MIN_LFO_AMOUNT, MAX_LFO_AMOUNT);
         printf("%d\n", value);
         lfo_amount = static_cast<float>(value) / static_cast<float>(MAX_LFO_AMOUNT);
+
+        while ((getchar()) != '\n'); // flush stdin
+
+        printf("\nSweep the filter cutoff instead of the volume? [y/n]\t");
+        ch = static_cast<char>(getchar());
+        lfo_filter = (ch == 'y' || ch == 'Y');
+        printf("%c\n", lfo_filter ? 'y' : 'n');
     }
 
     while ((getchar()) != '\n'); // flush stdin
@@ -105,14 +121,15 @@ void user_params::get_user_params(play_params *data)
     while ((getchar()) != '\n'); // flush stdin
 
     data->init(note_num_frames, (disable_fadeout ? max_lenght_samples : INVALID_MAX_FRAMES), pitch_deviation, volume_lower_bound, lpf_freq,
-        lpf_q, lfo_freq, lfo_amount, bpm, use_lfo, enable_dist, enable_fp_wf, rnd_note_length);
+        lpf_q, lfo_freq, lfo_amount, bpm, use_lfo, enable_dist, enable_fp_wf, rnd_note_length, rnd_filter,
+        lfo_filter);
 }
 
-static const char* input_args[] = { "--no-fadeout", "-s=" };
+static const char* input_args[] = { "--no-fadeout", "-s=", "--render", "--seconds", "--seed", "--cache-mb", "--allow-repeats", "--sinc" };
 
 void user_params::process_cmdline_args(int argc, char **argv)
 {
-     for (int i = 1, sz = _min(argc, (_countof(input_args)+1)); i < sz; i++) {
+     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], input_args[0])) {
             disable_fadeout = true;
         } else if (argv[i] == strstr(argv[i], input_args[1])) {
@@ -123,13 +140,42 @@ void user_params::process_cmdline_args(int argc, char **argv)
                 smoothing_lvl = clampr(smoothing_lvl, VIZ_BUFFER_SMOOTHING_LEVEL_MIN, VIZ_BUFFER_SMOOTHING_LEVEL_MAX);
                 waveform_smoothing_level = smoothing_lvl;
             }
+        } else if (!strcmp(argv[i], input_args[2]) && (i + 1 < argc)) {
+            render_path = argv[++i];
+        } else if (!strcmp(argv[i], input_args[3]) && (i + 1 < argc)) {
+            char* end_ptr;
+            const char* str = argv[++i];
+            int32_t seconds = (int32_t)strtol(str, &end_ptr, 10);
+            if (end_ptr != str) {
+                seconds = clampr(seconds, MIN_RENDER_SECONDS, MAX_RENDER_SECONDS);
+                render_seconds = seconds;
+            }
+        } else if (!strcmp(argv[i], input_args[4]) && (i + 1 < argc)) {
+            char* end_ptr;
+            const char* str = argv[++i];
+            const int64_t value = (int64_t)strtoll(str, &end_ptr, 10);
+            if (end_ptr != str) {
+                seed = value;
+            }
+        } else if (!strcmp(argv[i], input_args[5]) && (i + 1 < argc)) {
+            char* end_ptr;
+            const char* str = argv[++i];
+            int32_t size_mb = (int32_t)strtol(str, &end_ptr, 10);
+            if (end_ptr != str) {
+                size_mb = clampr(size_mb, MIN_CACHE_MB, MAX_CACHE_MB);
+                cache_size_mb = size_mb;
+            }
+        } else if (!strcmp(argv[i], input_args[6])) {
+            allow_repeats = true;
+        } else if (!strcmp(argv[i], input_args[7])) {
+            sinc_resampling = true;
         }
         // ...
     }
 }
 
 // main thread loop
-void user_params::run_user_loop(pa_data &data, triple_buffer<play_params> *p_params)
+void user_params::run_user_loop(audio_renderer &renderer)
 {
     do {
         puts("\nEnter \'q\' to stop the playback or \'p\' to change parameters...");
@@ -137,9 +183,9 @@ void user_params::run_user_loop(pa_data &data, triple_buffer<play_params> *p_par
         if (ch == 'q' || ch == 'Q') {
             break;
         } else if (ch == 'p' || ch == 'P') { 
-            play_params* params_back_buffer_ptr = p_params->get_back_buffer();
-            get_user_params(params_back_buffer_ptr);
-            p_params->publish();
+            play_params params;
+            get_user_params(&params);
+            renderer.set_params(params);
         } else {
             while ((getchar()) != '\n'); // flush stdin
         }
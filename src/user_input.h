@@ -8,11 +8,19 @@ struct user_params {
 	// cmd args
 	int32_t waveform_smoothing_level;
 	bool disable_fadeout;
+	const char* render_path; // offline rendering, if set
+	int32_t render_seconds;
+	int64_t seed;
+	int32_t cache_size_mb; // sample cache budget, decoded and mapped files
+	bool allow_repeats; // otherwise a file comes up again only after all the others
+	bool sinc_resampling; // polyphase sinc instead of linear interpolation when pitching
 
 public:
-	user_params() : max_lenght_samples(0), waveform_smoothing_level(VIZ_BUFFER_SMOOTHING_LEVEL_DEF), disable_fadeout(false) {}
+	user_params() : max_lenght_samples(0), waveform_smoothing_level(VIZ_BUFFER_SMOOTHING_LEVEL_DEF), disable_fadeout(false),
+		render_path(nullptr), render_seconds(DEFAULT_RENDER_SECONDS), seed(DEFAULT_RANDOM_SEED),
+		cache_size_mb(DEFAULT_CACHE_MB), allow_repeats(false), sinc_resampling(false) {}
 	bool get_folder_path();
 	void get_user_params(play_params* data);
 	void process_cmdline_args(int argc, char** argv);
-	void run_user_loop(pa_data& data, triple_buffer<play_params>* p_params);
+	void run_user_loop(audio_renderer& renderer);
 };
@@ -3,8 +3,11 @@
 #include <array>
 
 #include "emmintrin.h"
+#include "broadcast_channel.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
 
-using audio_file_container = std::array<AudioFile<float>, (1 << NUM_FILES_POW_2)>;
 using buffer_container = std::array<std::vector<__m128>, NUM_CHANNELS>;
 using output_buffer_container = std::vector<__m128>;
 using waveform_container = std::array<__m128i, FRAMES_PER_BUFFER * NUM_CHANNELS / FP_IN_VEC>; // big enough size is required to fit either s16 or floats
@@ -14,6 +17,9 @@ struct waveform_data {
     bool fp_mode = false;
 };
 
+// render thread -> fft, waveform view and any other audio taps
+using waveform_channel = broadcast_channel<waveform_data, WAVEFORM_CHANNEL_POW_2, MAX_WAVEFORM_CONSUMERS>;
+
 #define verify_pa_no_error_verbose(err)\
 if( (err) != paNoError ) {\
     printf(  "PortAudio error: %s\n", Pa_GetErrorText( err ) );\
@@ -49,4 +55,23 @@ inline uint32_t find_next_pow2(uint32_t v) {
 	v |= v >> 16;
 	v++;
 	return	v;
-}
\ No newline at end of file
+}
+
+inline uint32_t bit_scan_forward(uint64_t v) {
+	assert(v);
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward64(&idx, v);
+	return	static_cast<uint32_t>(idx);
+#else
+	return	static_cast<uint32_t>(__builtin_ctzll(v));
+#endif // _MSC_VER
+}
+
+inline uint32_t pop_count(uint64_t v) {
+#ifdef _MSC_VER
+	return	static_cast<uint32_t>(__popcnt64(v));
+#else
+	return	static_cast<uint32_t>(__builtin_popcountll(v));
+#endif // _MSC_VER
+}
@@ -143,8 +143,15 @@ void visualizer::run_gl()
 
         glClear(GL_COLOR_BUFFER_BIT);
 
-        waveform_data* wf_data_front_buf_ptr = waveform.waveform_buffer->consume();
-        const bool fp_mode = wf_data_front_buf_ptr->fp_mode;
+        // copied out first - the producer may overwrite the slot while it's being read, then the copy is dropped
+        bool new_data = false;
+        if (const waveform_data* wf_data = waveform.waveform_input->begin_reading_latest(waveform.consumer_id)) {
+            waveform_data copy = *wf_data;
+            new_data = waveform.waveform_input->end_consuming(waveform.consumer_id);
+            if (new_data)
+                waveform.staging = copy;
+        }
+        const bool fp_mode = waveform.staging.fp_mode;
         const size_t data_size = !fp_mode ? sizeof(int16_t) : sizeof(float);
 
         // UBO -- shared between the shader programs
@@ -162,9 +169,11 @@ void visualizer::run_gl()
             const int32_t ssbo_frame = int32_t(frame % waveform.waveform_smoothing_level);
             const size_t ssbo_size = VIZ_BUFFER_SIZE * data_size;
             const size_t ssbo_offset = ssbo_size * ssbo_frame;
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, waveform.SSBO);
-            glBufferSubData(GL_SHADER_STORAGE_BUFFER, ssbo_offset, ssbo_size, wf_data_front_buf_ptr->container.data());
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            if (new_data) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, waveform.SSBO);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, ssbo_offset, ssbo_size, waveform.staging.container.data());
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
             // other uniforms 
             waveform.shader.set_uniform("smoothing_level", waveform.waveform_smoothing_level); // used to calculate the offset within the SSBO
 
@@ -215,9 +224,10 @@ void visualizer::deinit_gl()
     glDeleteBuffers(3, fft.SSBO);
 }
 
-void visualizer::init(triple_buffer<waveform_data>* wf_buf, int32_t smoothing_level, compute_fft* fft_comp)
+void visualizer::init(waveform_channel* wf_channel, int32_t smoothing_level, compute_fft* fft_comp)
 {
-    waveform.waveform_buffer = wf_buf;
+    waveform.waveform_input = wf_channel;
+    waveform.consumer_id = wf_channel->add_consumer("Waveform view", false);
     waveform.waveform_smoothing_level = smoothing_level;
     compute_cl = fft_comp;
 
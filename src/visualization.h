@@ -3,6 +3,8 @@
 #include <atomic>
 #include <thread>
 
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 #include <GL/glew.h>
 #include "Window.h"
 #include "Shader.h"
@@ -17,7 +19,9 @@ class visualizer
 {
 public:
     struct waveform_t {
-        triple_buffer<waveform_data>* waveform_buffer = nullptr;
+        waveform_channel* waveform_input = nullptr;
+        size_t consumer_id = 0;
+        waveform_data staging; // the last block that was copied out of the channel intact
         r_shader shader;
         GLuint VAO;
         GLuint SSBO;
@@ -51,7 +55,7 @@ private:
 public:
     visualizer();
 
-    void init(triple_buffer<waveform_data>* wf_buf, int32_t smoothing_level, compute_fft* fft_comp);
+    void init(waveform_channel* wf_channel, int32_t smoothing_level, compute_fft* fft_comp);
     void deinit() 
     { 
         state_render.store(0); 
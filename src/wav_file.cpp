@@ -0,0 +1,289 @@
+#include "wav_file.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+#pragma pack(push, 1)
+struct wav_float_header
+{
+    char riff_id[4];
+    uint32_t riff_size;
+    char wave_id[4];
+    char fmt_id[4];
+    uint32_t fmt_size;
+    uint16_t format_tag;
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint16_t extension_size;
+    char fact_id[4]; // non-PCM formats carry a fact chunk
+    uint32_t fact_size;
+    uint32_t num_frames;
+    char data_id[4];
+    uint32_t data_size;
+};
+#pragma pack(pop)
+
+bool wav_writer::open(const char *path, uint32_t num_channels, uint32_t sample_rate)
+{
+    close();
+    _fp = fopen(path, "wb");
+    if (!_fp) {
+        return false;
+    }
+    _num_channels = num_channels;
+    _sample_rate = sample_rate;
+    _num_frames = 0;
+    // placeholder, the sizes are known only after the last frame is written
+    return write_header();
+}
+
+bool wav_writer::write(const float *frames, size_t num_frames)
+{
+    if (fwrite(frames, sizeof(float) * _num_channels, num_frames, _fp) != num_frames) {
+        return false;
+    }
+    _num_frames += static_cast<uint32_t>(num_frames);
+    return true;
+}
+
+bool wav_writer::close()
+{
+    if (!_fp) {
+        return true;
+    }
+    bool res = !fseek(_fp, 0, SEEK_SET) && write_header();
+    res &= !fclose(_fp);
+    _fp = nullptr;
+    return res;
+}
+
+bool wav_writer::write_header()
+{
+    const uint32_t block_align = _num_channels * static_cast<uint32_t>(sizeof(float));
+    const uint32_t data_size = _num_frames * block_align;
+
+    wav_float_header header;
+    memcpy(header.riff_id, "RIFF", 4);
+    header.riff_size = static_cast<uint32_t>(sizeof(wav_float_header)) - 8 + data_size;
+    memcpy(header.wave_id, "WAVE", 4);
+    memcpy(header.fmt_id, "fmt ", 4);
+    header.fmt_size = 18;
+    header.format_tag = WAVE_FORMAT_IEEE_FLOAT;
+    header.num_channels = static_cast<uint16_t>(_num_channels);
+    header.sample_rate = _sample_rate;
+    header.byte_rate = _sample_rate * block_align;
+    header.block_align = static_cast<uint16_t>(block_align);
+    header.bits_per_sample = 32;
+    header.extension_size = 0;
+    memcpy(header.fact_id, "fact", 4);
+    header.fact_size = 4;
+    header.num_frames = _num_frames;
+    memcpy(header.data_id, "data", 4);
+    header.data_size = data_size;
+
+    return fwrite(&header, sizeof(header), 1, _fp) == 1;
+}
+
+bool wav_info::is_float32() const
+{
+    return format_tag == WAVE_FORMAT_IEEE_FLOAT && bits_per_sample == 32;
+}
+
+bool wav_info::is_mappable() const
+{
+    const bool supported = is_float32() || (format_tag == WAVE_FORMAT_PCM &&
+                                            (bits_per_sample == 16 || bits_per_sample == 24 || bits_per_sample == 32));
+    return supported && (block_align == num_channels * (bits_per_sample / 8));
+}
+
+bool wav_info::is_decodable() const
+{
+    return num_frames && (is_float32() || (format_tag == WAVE_FORMAT_PCM && (bits_per_sample == 8 || is_mappable())));
+}
+
+bool wav_mapping::open(const char *path)
+{
+    if (!map(path)) {
+        return false;
+    }
+    if (!_info.is_mappable()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool wav_mapping::probe(const char *path, wav_info &info)
+{
+    wav_mapping mapping;
+    if (!mapping.map(path)) {
+        return false;
+    }
+    info = mapping._info;
+    return true;
+}
+
+bool wav_mapping::map(const char *path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = nullptr;
+    if (::GetFileSizeEx(file, &file_size) && file_size.QuadPart) {
+        mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    if (mapping) {
+        _view = static_cast<const uint8_t *>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        _view_size = static_cast<size_t>(file_size.QuadPart);
+        // the view keeps the mapping alive
+        ::CloseHandle(mapping);
+    }
+    ::CloseHandle(file);
+#else
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (!fstat(fd, &st) && st.st_size) {
+        void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (view != MAP_FAILED) {
+            _view = static_cast<const uint8_t *>(view);
+            _view_size = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+#endif // _WIN32
+    if (!_view) {
+        return false;
+    }
+    if (!parse_header()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void wav_mapping::close()
+{
+    if (_view) {
+#ifdef _WIN32
+        ::UnmapViewOfFile(_view);
+#else
+        munmap(const_cast<uint8_t *>(_view), _view_size);
+#endif // _WIN32
+    }
+    _view = nullptr;
+    _view_size = 0;
+    _frames = nullptr;
+    _info = wav_info{};
+}
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+bool wav_mapping::parse_header()
+{
+    if (_view_size < 12 || memcmp(_view, "RIFF", 4) || memcmp(_view + 8, "WAVE", 4)) {
+        return false;
+    }
+    bool fmt_found = false;
+    size_t offset = 12;
+    while ((offset + 8) <= _view_size) {
+        const uint8_t *chunk = _view + offset;
+        const size_t chunk_size = read_u32(chunk + 4);
+        const size_t body = offset + 8;
+        if (!memcmp(chunk, "fmt ", 4)) {
+            if (chunk_size < 16 || (body + chunk_size) > _view_size) {
+                return false;
+            }
+            _info.format_tag = read_u16(chunk + 8);
+            if (_info.format_tag == WAVE_FORMAT_EXTENSIBLE && chunk_size >= 40) {
+                _info.format_tag = read_u16(chunk + 32); // first two bytes of the subformat GUID
+            }
+            _info.num_channels = read_u16(chunk + 10);
+            _info.sample_rate = read_u32(chunk + 12);
+            _info.block_align = read_u16(chunk + 20);
+            _info.bits_per_sample = read_u16(chunk + 22);
+            if (!_info.num_channels || !_info.block_align) {
+                return false;
+            }
+            fmt_found = true;
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!fmt_found) {
+                return false;
+            }
+            // a truncated file is played up to its last complete frame
+            const size_t data_size = (chunk_size < (_view_size - body)) ? chunk_size : (_view_size - body);
+            _frames = _view + body;
+            _info.num_frames = data_size / _info.block_align;
+            return _info.num_frames != 0;
+        }
+        offset = body + chunk_size + (chunk_size & 1); // chunks are word aligned
+    }
+    return false;
+}
+
+void wav_mapping::read_frames(size_t first_frame, size_t num_frames, float *const *dest, size_t num_dest_channels) const
+{
+    assert((first_frame + num_frames) <= _info.num_frames);
+    const size_t bytes_per_sample = _info.bits_per_sample / 8;
+    const size_t frame_size = _info.block_align;
+    const size_t num_channels = (num_dest_channels < _info.num_channels) ? num_dest_channels : _info.num_channels;
+    const bool is_float = _info.is_float32();
+    constexpr float s16_scale = 1.0f / 32768.0f;
+    constexpr float s24_scale = 1.0f / 8388608.0f;
+    constexpr float s32_scale = 1.0f / 2147483648.0f;
+    for (size_t ch = 0; ch < num_channels; ch++) {
+        const uint8_t *src = _frames + first_frame * frame_size + ch * bytes_per_sample;
+        float *dst = dest[ch];
+        if (is_float) {
+            for (size_t i = 0; i < num_frames; i++, src += frame_size)
+                memcpy(dst + i, src, sizeof(float));
+        } else if (bytes_per_sample == 2) {
+            for (size_t i = 0; i < num_frames; i++, src += frame_size)
+                dst[i] = static_cast<float>(static_cast<int16_t>(read_u16(src))) * s16_scale;
+        } else if (bytes_per_sample == 3) {
+            for (size_t i = 0; i < num_frames; i++, src += frame_size) {
+                // sign-extend through the top byte of a 32-bit word
+                const int32_t v = static_cast<int32_t>((uint32_t(src[0]) << 8) | (uint32_t(src[1]) << 16) | (uint32_t(src[2]) << 24)) >> 8;
+                dst[i] = static_cast<float>(v) * s24_scale;
+            }
+        } else {
+            for (size_t i = 0; i < num_frames; i++, src += frame_size)
+                dst[i] = static_cast<float>(static_cast<int32_t>(read_u32(src))) * s32_scale;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// streams interleaved fp32 frames to disk, the chunk sizes are patched in on close
+class wav_writer
+{
+    FILE *_fp;
+    uint32_t _num_channels;
+    uint32_t _sample_rate;
+    uint32_t _num_frames;
+
+  public:
+    wav_writer() : _fp(nullptr), _num_channels(0), _sample_rate(0), _num_frames(0)
+    {
+    }
+    ~wav_writer()
+    {
+        close();
+    }
+
+    // C5220
+    wav_writer(const wav_writer&) = delete;
+    wav_writer& operator=(const wav_writer&) = delete;
+    wav_writer(wav_writer&&) = delete;
+    wav_writer& operator=(wav_writer&&) = delete;
+
+    bool open(const char *path, uint32_t num_channels, uint32_t sample_rate);
+    bool write(const float *frames, size_t num_frames);
+    bool close();
+
+  private:
+    bool write_header();
+};
+
+// what the header of a WAV file says about its data, any encoding
+struct wav_info
+{
+    uint16_t format_tag; // the subformat for WAVE_FORMAT_EXTENSIBLE
+    uint16_t num_channels;
+    uint32_t sample_rate;
+    uint16_t bits_per_sample;
+    uint16_t block_align;
+    size_t num_frames;
+
+    bool is_float32() const;
+    // 16/24/32-bit PCM and 32-bit float - can be read in place
+    bool is_mappable() const;
+    // anything AudioFile can decode
+    bool is_decodable() const;
+};
+
+// read-only view of a PCM or IEEE float WAV file - fp32 samples can be used in place (interleaved),
+// no decoding, no copies. Pages are faulted in on first access and shared through the page cache
+class wav_mapping
+{
+    const uint8_t *_view;
+    size_t _view_size;
+    const uint8_t *_frames; // interleaved, not necessarily sample aligned
+    wav_info _info;
+
+  public:
+    wav_mapping() : _view(nullptr), _view_size(0), _frames(nullptr), _info{}
+    {
+    }
+    ~wav_mapping()
+    {
+        close();
+    }
+
+    // C5220
+    wav_mapping(const wav_mapping&) = delete;
+    wav_mapping& operator=(const wav_mapping&) = delete;
+    wav_mapping(wav_mapping&&) = delete;
+    wav_mapping& operator=(wav_mapping&&) = delete;
+
+    // false if the file can't be mapped or isn't 16/24/32-bit PCM or 32-bit float
+    bool open(const char *path);
+    void close();
+    // converts frames to planar floats, touching only the pages they live on
+    void read_frames(size_t first_frame, size_t num_frames, float *const *dest, size_t num_dest_channels) const;
+    // reads only the header pages, whatever the encoding
+    static bool probe(const char *path, wav_info &info);
+
+    const uint8_t *frames() const { return _frames; }
+    uint32_t num_channels() const { return _info.num_channels; }
+    uint32_t sample_rate() const { return _info.sample_rate; }
+    size_t num_frames() const { return _info.num_frames; }
+    bool is_float32() const { return _info.is_float32(); }
+
+  private:
+    bool map(const char *path);
+    bool parse_header();
+};
\ No newline at end of file
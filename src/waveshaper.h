@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "constants.h"
+#include "cpu_features.h"
+#include "dsp.h"
+
+// waveshaper kernels - every stage scales the sample by coef_pos or coef_neg on its sign, runs it through fast_atan
+// and divides by fast_atan of the same coef. The coef only has two values, so the division and the stage's inversion
+// fold into a constant per stage and sign, computed once per call.
+// The SSE2 kernel does exactly the arithmetic of the loop it replaced, the AVX2 one contracts it into FMAs
+namespace dsp
+{
+namespace waveshaper
+{
+constexpr uint32_t max_stages = 16;
+
+// PI_DIV_4 * x - x * (|x| - 1) * (0.2447 + 0.0663 * |x|)
+inline __m128 fast_atan(__m128 x)
+{
+    const __m128 abs_x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+    const __m128 temp = _mm_mul_ps(_mm_sub_ps(abs_x, _mm_set1_ps(1.0f)), x);
+    const __m128 poly = _mm_add_ps(_mm_mul_ps(abs_x, _mm_set1_ps(0.0663f)), _mm_set1_ps(0.2447f));
+    return _mm_sub_ps(_mm_mul_ps(x, _mm_set1_ps(PI_DIV_4)), _mm_mul_ps(temp, poly));
+}
+
+struct stage_constants
+{
+    float out_pos[max_stages]; // 1 / fast_atan(coef_pos), negated on the inverting stages
+    float out_neg[max_stages];
+    uint32_t num_stages;
+};
+
+inline stage_constants prepare(const params &p)
+{
+    assert(p.num_stages <= max_stages);
+    alignas(16) float inv_atan[4];
+    const __m128 coefs = _mm_setr_ps(p.coef_pos, p.coef_neg, 1.0f, 1.0f);
+    _mm_store_ps(inv_atan, _mm_div_ps(_mm_set1_ps(1.0f), fast_atan(coefs)));
+
+    stage_constants k;
+    k.num_stages = p.num_stages;
+    for (uint32_t j = 0; j < p.num_stages; j++) {
+        const bool invert = (p.invert_stages & j) != 0;
+        k.out_pos[j] = invert ? -inv_atan[0] : inv_atan[0];
+        k.out_neg[j] = invert ? -inv_atan[1] : inv_atan[1];
+    }
+    return k;
+}
+
+inline __m128 stage_sse2(__m128 x, __m128 c_pos, __m128 c_neg, __m128 out_pos, __m128 out_neg)
+{
+    const __m128 neg = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(x), 0x1f));
+    const __m128 coef = _mm_or_ps(_mm_and_ps(neg, c_neg), _mm_andnot_ps(neg, c_pos));
+    const __m128 out = _mm_or_ps(_mm_and_ps(neg, out_neg), _mm_andnot_ps(neg, out_pos));
+    return _mm_mul_ps(fast_atan(_mm_mul_ps(x, coef)), out);
+}
+
+// num_frames has to be divisible by 4. 4 vectors go through a stage together - the stages of one vector
+// are a single dependency chain
+inline void process_sse2(float *samples, size_t num_frames, const stage_constants &k, const params &p)
+{
+    assert((num_frames & 0x3) == 0x0);
+    const __m128 c_pos = _mm_set1_ps(p.coef_pos);
+    const __m128 c_neg = _mm_set1_ps(p.coef_neg);
+    const __m128 gain = _mm_set1_ps(p.gain);
+    size_t i = 0;
+    for (; i + 16 <= num_frames; i += 16) {
+        __m128 s0 = _mm_loadu_ps(samples + i);
+        __m128 s1 = _mm_loadu_ps(samples + i + 4);
+        __m128 s2 = _mm_loadu_ps(samples + i + 8);
+        __m128 s3 = _mm_loadu_ps(samples + i + 12);
+        for (uint32_t j = 0; j < k.num_stages; j++) {
+            const __m128 out_pos = _mm_set1_ps(k.out_pos[j]);
+            const __m128 out_neg = _mm_set1_ps(k.out_neg[j]);
+            s0 = stage_sse2(s0, c_pos, c_neg, out_pos, out_neg);
+            s1 = stage_sse2(s1, c_pos, c_neg, out_pos, out_neg);
+            s2 = stage_sse2(s2, c_pos, c_neg, out_pos, out_neg);
+            s3 = stage_sse2(s3, c_pos, c_neg, out_pos, out_neg);
+        }
+        _mm_storeu_ps(samples + i, _mm_mul_ps(s0, gain));
+        _mm_storeu_ps(samples + i + 4, _mm_mul_ps(s1, gain));
+        _mm_storeu_ps(samples + i + 8, _mm_mul_ps(s2, gain));
+        _mm_storeu_ps(samples + i + 12, _mm_mul_ps(s3, gain));
+    }
+    for (; i < num_frames; i += 4) {
+        __m128 s = _mm_loadu_ps(samples + i);
+        for (uint32_t j = 0; j < k.num_stages; j++)
+            s = stage_sse2(s, c_pos, c_neg, _mm_set1_ps(k.out_pos[j]), _mm_set1_ps(k.out_neg[j]));
+        _mm_storeu_ps(samples + i, _mm_mul_ps(s, gain));
+    }
+}
+
+TARGET_AVX2_FMA inline __m256 stage_avx2(__m256 x, __m256 c_pos, __m256 c_neg, __m256 out_pos, __m256 out_neg)
+{
+    // blendv picks on the sign bit, no mask needed - both on the input's, like stage_sse2
+    const __m256 out = _mm256_blendv_ps(out_pos, out_neg, x);
+    x = _mm256_mul_ps(x, _mm256_blendv_ps(c_pos, c_neg, x));
+    const __m256 abs_x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)));
+    const __m256 temp = _mm256_fmsub_ps(abs_x, x, x); // (|x| - 1) * x
+    const __m256 poly = _mm256_fmadd_ps(abs_x, _mm256_set1_ps(0.0663f), _mm256_set1_ps(0.2447f));
+    return _mm256_mul_ps(_mm256_fnmadd_ps(temp, poly, _mm256_mul_ps(x, _mm256_set1_ps(PI_DIV_4))), out);
+}
+
+// like process_sse2, 4 vectors of 8 at a time, the frames left over go through the SSE2 kernel
+TARGET_AVX2_FMA inline void process_avx2(float *samples, size_t num_frames, const stage_constants &k, const params &p)
+{
+    assert((num_frames & 0x3) == 0x0);
+    const __m256 c_pos = _mm256_set1_ps(p.coef_pos);
+    const __m256 c_neg = _mm256_set1_ps(p.coef_neg);
+    const __m256 gain = _mm256_set1_ps(p.gain);
+    size_t i = 0;
+    for (; i + 32 <= num_frames; i += 32) {
+        __m256 s0 = _mm256_loadu_ps(samples + i);
+        __m256 s1 = _mm256_loadu_ps(samples + i + 8);
+        __m256 s2 = _mm256_loadu_ps(samples + i + 16);
+        __m256 s3 = _mm256_loadu_ps(samples + i + 24);
+        for (uint32_t j = 0; j < k.num_stages; j++) {
+            const __m256 out_pos = _mm256_broadcast_ss(&k.out_pos[j]);
+            const __m256 out_neg = _mm256_broadcast_ss(&k.out_neg[j]);
+            s0 = stage_avx2(s0, c_pos, c_neg, out_pos, out_neg);
+            s1 = stage_avx2(s1, c_pos, c_neg, out_pos, out_neg);
+            s2 = stage_avx2(s2, c_pos, c_neg, out_pos, out_neg);
+            s3 = stage_avx2(s3, c_pos, c_neg, out_pos, out_neg);
+        }
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(s0, gain));
+        _mm256_storeu_ps(samples + i + 8, _mm256_mul_ps(s1, gain));
+        _mm256_storeu_ps(samples + i + 16, _mm256_mul_ps(s2, gain));
+        _mm256_storeu_ps(samples + i + 24, _mm256_mul_ps(s3, gain));
+    }
+    if (i < num_frames)
+        process_sse2(samples + i, num_frames - i, k, p);
+}
+} // namespace waveshaper
+} // namespace dsp